@@ -3,37 +3,28 @@
 #include <iomanip>
 #include <string>
 
-#include "tbprobe.h"
 #include "lib/surge/src/position.h"
 
+#include "src/bench.h"
 #include "src/eval.h"
 #include "src/OpeningDB.h"
 #include "src/search.h"
+#include "src/uci.h"
 
 using namespace std;
 
 OpeningDB opening_db;
 
-int main() {
-    // Initialze Syzygy
-    if (!tb_init("/home/fabian/CLionProjects/Chess/data/syzygy")) {
-        cerr << "Failed to initialize Syzygy tablebases.\n";
-        return 1;
-    }
-
-    // Initialize surge
-    initialise_all_databases();
-    zobrist::initialise_zobrist_keys();
-
-    opening_db.load_from_csv("/home/fabian/CLionProjects/Chess/data/my_openings_l.csv");
-
-    Position p;
-    //Position::set("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq -", p);
-    Position::set("1rq2rk1/pb1nbp1p/2p1p1p1/3nP3/Np1PQ3/1P1B1NP1/P1R2P1P/2BR2K1 b -  -", p);
+// Human (White) against the engine on the console
+static int play_interactive() {
+    Board p;
+    //Board::set("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq -", p);
+    Board::set("1rq2rk1/pb1nbp1p/2p1p1p1/3nP3/Np1PQ3/1P1B1NP1/P1R2P1P/2BR2K1 b -  -", p);
     cout << "Starting FEN: " << p.fen() << "\n";
 
-    int max_depth = 12; // AI search depth
-    int time_limit_ms = 7000;
+    SearchLimits limits;
+    limits.depth = 12;          // AI search depth
+    limits.moveTimeMs = 7000;
 
     while (true) {
         cout << p << "\n";
@@ -79,7 +70,8 @@ int main() {
 
             // AI move
             cout << "AI thinking...\n";
-            Move best = find_best_move<BLACK>(p, max_depth, time_limit_ms);
+            prepare_search(limits);
+            Move best = find_best_move<BLACK>(p, limits);
             cout << "AI plays: " << best << "\n";
             p.play<BLACK>(best);
         }
@@ -88,3 +80,24 @@ int main() {
     cout << "Final FEN: " << p.fen() << "\n";
     return 0;
 }
+
+int main(int argc, char **argv) {
+    // Initialize surge
+    initialise_all_databases();
+    zobrist::initialise_zobrist_keys();
+
+    // "play" starts a console game and "bench [depth] [threads] [hash MB] [split]" runs the benchmark;
+    // otherwise the engine speaks UCI, tablebases, book and network are configured with setoption
+    if (argc > 1 && string(argv[1]) == "play") return play_interactive();
+    if (argc > 1 && string(argv[1]) == "bench") {
+        int depth = argc > 2 ? stoi(argv[2]) : 8;
+        int threads = argc > 3 ? stoi(argv[3]) : 1;
+        int hashMb = argc > 4 ? stoi(argv[4]) : 16;
+        bool splitPoints = argc > 5 && string(argv[5]) == "split";
+        bench(depth, threads, hashMb, splitPoints);
+        return 0;
+    }
+
+    uci_loop();
+    return 0;
+}
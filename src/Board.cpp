@@ -0,0 +1,176 @@
+//
+// Created by fabian on 10/18/26.
+//
+
+#include "Board.h"
+
+#include <algorithm>
+#include <sstream>
+
+void Board::set(const std::string &fen, Board &b) {
+    Position::set(fen, b);
+    b.sp = 0;
+    b.refresh();
+
+    // optional half move clock and full move number after the four FEN fields
+    std::istringstream ss(fen);
+    std::string field;
+    int halfmove = 0, fullmove = 1;
+    for (int i = 0; i < 4; ++i) ss >> field;
+    ss >> halfmove >> fullmove;
+    // Position::set reads the en passant field wrongly after castling rights: it takes the 'e' of "KQkq e6"
+    // for a castling letter, and after "KQkq -" the half move clock for the square
+    const bool ep = field.size() == 2 && field[0] >= 'a' && field[0] <= 'h' && (field[1] == '3' || field[1] == '6');
+    b.history[b.ply()].epsq = ep ? create_square(File(field[0] - 'a'), Rank(field[1] - '1')) : NO_SQUARE;
+    b.states[0].rule50 = std::max(0, halfmove);
+    b.states[0].pliesFromNull = b.states[0].rule50;
+    b.plyOffset = std::max(0, 2 * (fullmove - 1)) + (b.turn() == BLACK ? 1 : 0);
+}
+
+std::string Board::fen() const {
+    // Position::fen runs the castling rights and the en passant square together ("KQkqe6"), which set
+    // would read as one field, so only its piece placement is used
+    const std::string placement = Position::fen();
+    const UndoInfo &info = history[ply()];
+    std::string castling;
+    if (!(info.entry & WHITE_OO_MASK)) castling += 'K';
+    if (!(info.entry & WHITE_OOO_MASK)) castling += 'Q';
+    if (!(info.entry & BLACK_OO_MASK)) castling += 'k';
+    if (!(info.entry & BLACK_OOO_MASK)) castling += 'q';
+
+    std::ostringstream ss;
+    ss << placement.substr(0, placement.find(' ')) << (turn() == WHITE ? " w " : " b ")
+       << (castling.empty() ? "-" : castling) << " " << (info.epsq == NO_SQUARE ? "-" : SQSTR[info.epsq])
+       << " " << rule50() << " " << game_ply() / 2 + 1;
+    return ss.str();
+}
+
+void Board::refresh() {
+    BoardState &st = states[sp];
+    st.psqt = 0;
+    st.phase = 0;
+    st.key = get_hash();
+    st.pawnKey = 0;
+    st.nChanged = 0;
+    for (int sq = 0; sq < 64; ++sq) {
+        Piece pc = at(Square(sq));
+        st.psqt += PSQT[pc][sq];
+        st.phase += PIECE_PHASE[type_of(pc)];
+        if (type_of(pc) == PAWN) st.pawnKey ^= zobrist::zobrist_table[pc][sq];
+    }
+}
+
+void Board::set_prior_keys(const std::vector<uint64_t> &keys) {
+    priorCount = int(std::min<size_t>(keys.size(), MAX_PRIOR_KEYS));
+    std::copy(keys.end() - priorCount, keys.end(), priorKeys);
+}
+
+Board::Board(const Snapshot &s) : sp(0), plyOffset(s.plyOffset) {
+    std::copy(std::begin(s.pieceBB), std::end(s.pieceBB), piece_bb);
+    std::copy(std::begin(s.board), std::end(s.board), board);
+    side_to_play = s.side;
+    Position::game_ply = s.gamePly;
+    hash = s.hash;
+    history[Position::game_ply].entry = s.entry;
+    history[Position::game_ply].epsq = s.epsq;
+    states[0] = s.state;
+    priorCount = s.keyCount;
+    std::copy(s.keys, s.keys + s.keyCount, priorKeys);
+}
+
+Board::Snapshot Board::snapshot() const {
+    Snapshot s;
+    std::copy(std::begin(piece_bb), std::end(piece_bb), s.pieceBB);
+    std::copy(std::begin(board), std::end(board), s.board);
+    s.side = side_to_play;
+    s.gamePly = ply();
+    s.hash = hash;
+    s.entry = history[ply()].entry;
+    s.epsq = history[ply()].epsq;
+    s.state = states[sp];
+    s.plyOffset = plyOffset;
+    s.keyCount = std::min(reversible_plies(), sp + priorCount);
+    for (int i = s.keyCount; i >= 1; --i) s.keys[s.keyCount - i] = key_back(i);
+    return s;
+}
+
+std::vector<uint64_t> Board::game_keys() const {
+    std::vector<uint64_t> keys;
+    const int n = std::min(reversible_plies(), sp + priorCount);
+    for (int i = n; i >= 1; --i) keys.push_back(key_back(i));
+    return keys;
+}
+
+bool Board::is_repetition(int pliesFromRoot) const {
+    // only positions since the last capture or pawn move can repeat, and only with the same side to move
+    const int end = std::min(reversible_plies(), sp + priorCount);
+    const uint64_t key = states[sp].key;
+    int count = 0;
+    for (int i = 4; i <= end; i += 2) {
+        if (key_back(i) != key) continue;
+        if (i < pliesFromRoot || ++count == 2) return true;
+    }
+    return false;
+}
+
+// Every reversible move of a non-pawn piece, by the key difference it makes: both squares of the piece
+// and the side to move. 3668 moves fit into two tables of 8192 slots with cuckoo hashing.
+namespace {
+    struct Cuckoo {
+        uint64_t keys[8192] = {};
+        Move moves[8192] = {};
+
+        static int h1(uint64_t key) { return int(key & 0x1fff); }
+        static int h2(uint64_t key) { return int((key >> 16) & 0x1fff); }
+
+        Cuckoo() {
+            for (Piece pc : {WHITE_KNIGHT, WHITE_BISHOP, WHITE_ROOK, WHITE_QUEEN, WHITE_KING,
+                             BLACK_KNIGHT, BLACK_BISHOP, BLACK_ROOK, BLACK_QUEEN, BLACK_KING}) {
+                for (int s1 = 0; s1 < 64; ++s1) {
+                    for (int s2 = s1 + 1; s2 < 64; ++s2) {
+                        if (!(PSEUDO_LEGAL_ATTACKS[type_of(pc)][s1] & SQUARE_BB[s2])) continue;
+                        Move move{Square(s1), Square(s2)};
+                        uint64_t key = zobrist::zobrist_table[pc][s1] ^ zobrist::zobrist_table[pc][s2] ^ zobrist::side_key;
+                        // insert, pushing out whatever sits in the slot until an empty one is found
+                        int i = h1(key);
+                        while (true) {
+                            std::swap(keys[i], key);
+                            std::swap(moves[i], move);
+                            if (move == Move()) break;
+                            i = i == h1(key) ? h2(key) : h1(key);
+                        }
+                    }
+                }
+            }
+        }
+    };
+
+    // built on first use, when surge's zobrist keys are initialised
+    const Cuckoo &cuckoo() {
+        static const Cuckoo table;
+        return table;
+    }
+}
+
+bool Board::has_game_cycle(int pliesFromRoot) const {
+    const int end = std::min(reversible_plies(), sp + priorCount);
+    if (end < 3) return false;
+
+    const Cuckoo &c = cuckoo();
+    const uint64_t key = states[sp].key;
+    const Bitboard occupied = all_pieces<WHITE>() | all_pieces<BLACK>();
+
+    // positions an odd number of plies back have the other side to move, so one move can lead back there
+    for (int i = 3; i <= end && i < pliesFromRoot; i += 2) {
+        uint64_t moveKey = key ^ key_back(i);
+        int j = Cuckoo::h1(moveKey);
+        if (c.keys[j] != moveKey) {
+            j = Cuckoo::h2(moveKey);
+            if (c.keys[j] != moveKey) continue;
+        }
+        // the move must be possible: nothing in between its squares
+        Move m = c.moves[j];
+        if (!(SQUARES_BETWEEN_BB[m.from()][m.to()] & occupied)) return true;
+    }
+    return false;
+}
@@ -0,0 +1,224 @@
+//
+// Created by fabian on 10/18/26.
+//
+
+#ifndef CHESS_BOARD_H
+#define CHESS_BOARD_H
+
+#pragma once
+
+#include "../lib/surge/src/position.h"
+#include "psqt.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// surge's Position plus the state the engine keeps incrementally on top of it.
+// play/undo hide the Position versions: they update the extra state and forward to surge,
+// so everything that takes a Position (move generation, MoveList, SEE) keeps working on a Board.
+class Board : public Position {
+public:
+    Board() : sp(0), plyOffset(0) {
+        states[0] = BoardState{};
+    }
+
+    struct Snapshot;
+
+    // A board that continues from a snapshot: moves before it cannot be undone, but repetitions of them
+    // are still detected
+    explicit Board(const Snapshot &s);
+
+    // Sets up the position from a FEN and computes the incremental state from scratch.
+    // b must be freshly constructed, surge's Position::set does not clear the board.
+    static void set(const std::string &fen, Board &b);
+
+    // FEN including the move counters, which Position::fen leaves out
+    std::string fen() const;
+
+    // Half moves played in the game, counted from the full move number of the FEN
+    inline int game_ply() const { return plyOffset + ply(); }
+
+    template<Color C> void play(Move m);
+    template<Color C> void undo(Move m);
+
+    // Passes the move to the other side for null move pruning: flips the side and the key, clears the
+    // en passant square and pushes a state, so that the search below sees an ordinary position
+    template<Color C> void play_null();
+    template<Color C> void undo_null();
+
+    // Material and piece-square sum from White's point of view, midgame and endgame packed
+    inline EvalPair psqt() const { return states[sp].psqt; }
+
+    // Sum of PIECE_PHASE over the pieces on the board, from PHASE_MAX in the opening down to 0
+    inline int phase() const { return states[sp].phase; }
+
+    // Zobrist key of the pawns alone
+    inline uint64_t pawn_key() const { return states[sp].pawnKey; }
+
+    // Half moves since the last capture or pawn move
+    inline int rule50() const { return states[sp].rule50; }
+
+    // Half moves that a repetition can reach back: since the last capture, pawn move or null move
+    inline int reversible_plies() const { return std::min(states[sp].rule50, states[sp].pliesFromNull); }
+
+    // Keys of the positions played before the one passed to set, oldest first. Only the last 100 can still
+    // be repeated, older ones are dropped.
+    void set_prior_keys(const std::vector<uint64_t> &keys);
+
+    // Keys of the positions before the current one that a later position could still repeat, oldest first
+    std::vector<uint64_t> game_keys() const;
+
+    // True if the position occurred before: once is enough after the root of a search pliesFromRoot plies back,
+    // up to the root it must have occurred twice
+    bool is_repetition(int pliesFromRoot) const;
+
+    // True if the side to move can return to a position of the search with one reversible move, which
+    // makes the line at least a draw (cuckoo tables, after M. Goldstein's upcoming-repetition detection)
+    bool has_game_cycle(int pliesFromRoot) const;
+
+    // What a move changed on the board, so that evaluators can update their own state incrementally.
+    // Each changed square lists the piece that stood on it before and after the move (NO_PIECE if empty).
+    // No member initializers: the stack of 256 states is only written as the game goes, BoardState{} zeroes.
+    struct BoardState {
+        EvalPair psqt;
+        int phase;
+        uint64_t key;
+        uint64_t pawnKey;
+        int rule50;
+        int pliesFromNull;
+        int nChanged;
+        Square changed[4];
+        Piece removed[4];
+        Piece added[4];
+    };
+
+    // What a search thread needs to go on from the current position, about 1 KB instead of the ~20 KB of
+    // the whole Board with its history: the pieces, the state of the current position, the castling and
+    // en passant information of the last move and the keys that repetitions can still reach.
+    struct Snapshot {
+        Bitboard pieceBB[NPIECES];
+        Piece board[NSQUARES];
+        Color side;
+        int gamePly;
+        uint64_t hash;
+        Bitboard entry;         // UndoInfo of the current ply; its copy constructor would drop epsq
+        Square epsq;
+        BoardState state;
+        int plyOffset;
+        int keyCount;
+        uint64_t keys[100];     // oldest first
+    };
+
+    Snapshot snapshot() const;
+
+    // States are indexed from 0 (the position passed to set) to state_index() (the current position)
+    inline int state_index() const { return sp; }
+    inline const BoardState &state(int i) const { return states[i]; }
+
+private:
+    static constexpr int MAX_PRIOR_KEYS = sizeof(Snapshot::keys) / sizeof(uint64_t);
+
+    BoardState states[256];
+    int sp;
+    int plyOffset;
+    uint64_t priorKeys[MAX_PRIOR_KEYS];
+    int priorCount = 0;
+
+    // key of the position i plies before the current one, reaching back into the prior keys
+    inline uint64_t key_back(int i) const {
+        return i <= sp ? states[sp - i].key : priorKeys[priorCount - (i - sp)];
+    }
+
+    void refresh();
+};
+
+template<Color C>
+void Board::play(const Move m) {
+    // every square whose contents change: origin, target and the rook or e.p. pawn squares
+    Square squares[4] = {m.from(), m.to()};
+    int n = 2;
+    switch (m.flags()) {
+        case OO:
+            // surge encodes short castling as king takes rook
+            squares[1] = C == WHITE ? g1 : g8;
+            squares[2] = C == WHITE ? h1 : h8;
+            squares[3] = C == WHITE ? f1 : f8;
+            n = 4;
+            break;
+        case OOO:
+            squares[2] = C == WHITE ? a1 : a8;
+            squares[3] = C == WHITE ? d1 : d8;
+            n = 4;
+            break;
+        case EN_PASSANT:
+            squares[2] = m.to() + relative_dir<C>(SOUTH);
+            n = 3;
+            break;
+        default:
+            break;
+    }
+
+    BoardState &next = states[sp + 1];
+    EvalPair delta = 0;
+    int phase = states[sp].phase;
+    uint64_t pawnKey = states[sp].pawnKey;
+    next.nChanged = n;
+    for (int i = 0; i < n; ++i) {
+        next.changed[i] = squares[i];
+        next.removed[i] = at(squares[i]);
+        delta -= PSQT[next.removed[i]][squares[i]];
+        phase -= PIECE_PHASE[type_of(next.removed[i])];
+        if (type_of(next.removed[i]) == PAWN) pawnKey ^= zobrist::zobrist_table[next.removed[i]][squares[i]];
+    }
+
+    Position::play<C>(m);
+
+    for (int i = 0; i < n; ++i) {
+        next.added[i] = at(squares[i]);
+        delta += PSQT[next.added[i]][squares[i]];
+        phase += PIECE_PHASE[type_of(next.added[i])];
+        if (type_of(next.added[i]) == PAWN) pawnKey ^= zobrist::zobrist_table[next.added[i]][squares[i]];
+    }
+    // squares[0] is the origin, so removed[0] is the piece that moved
+    next.rule50 = (m.flags() & CAPTURE) || type_of(next.removed[0]) == PAWN ? 0 : states[sp].rule50 + 1;
+    next.pliesFromNull = states[sp].pliesFromNull + 1;
+    next.psqt = states[sp].psqt + delta;
+    next.phase = phase;
+    next.key = get_hash();
+    next.pawnKey = pawnKey;
+    ++sp;
+}
+
+template<Color C>
+void Board::undo(const Move m) {
+    Position::undo<C>(m);
+    --sp;
+}
+
+template<Color C>
+void Board::play_null() {
+    ++Position::game_ply;
+    history[Position::game_ply] = UndoInfo(history[Position::game_ply - 1]);
+    side_to_play = ~C;
+    hash ^= zobrist::side_key;
+
+    BoardState &next = states[sp + 1];
+    next.psqt = states[sp].psqt;
+    next.phase = states[sp].phase;
+    next.key = hash;
+    next.pawnKey = states[sp].pawnKey;
+    next.rule50 = states[sp].rule50 + 1;
+    next.pliesFromNull = 0;
+    next.nChanged = 0;
+    ++sp;
+}
+
+template<Color C>
+void Board::undo_null() {
+    --sp;
+    hash ^= zobrist::side_key;
+    side_to_play = C;
+    --Position::game_ply;
+}
+
+#endif //CHESS_BOARD_H
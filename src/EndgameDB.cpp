@@ -3,9 +3,12 @@
 //
 
 #include "EndgameDB.h"
+#include "SearchStats.h"
 
 #include "tbprobe.h"
 
+#include <algorithm>
+
 #define BOARD_RANK_1            0x00000000000000FFull
 #define BOARD_FILE_A            0x8080808080808080ull
 #define square(r, f)            (8 * (r) + (f))
@@ -144,7 +147,7 @@ static bool print_moves(struct tb_pos *pos, unsigned *results, bool prev,
 }
 
 
-void convertPosition(const Position& P, tb_pos& out) {
+static void convertPosition(const Board& P, tb_pos& out) {
     // Collect piece bitboards
     uint64_t WK = P.bitboard_of(WHITE_KING);
     uint64_t WQ = P.bitboard_of(WHITE_QUEEN);
@@ -176,8 +179,8 @@ void convertPosition(const Position& P, tb_pos& out) {
     // Move counter (half-moves since start)
     out.move = (P.ply() / 2) + 1;
 
-    // Rule 50 (not tracked explicitly in Position)
-    out.rule50 = 0; // Placeholder unless you track it separately
+    // Rule 50
+    out.rule50 = uint8_t(std::min(P.rule50(), 255));
 
     // En passant
     Square ep = P.history[P.ply()].epsq;
@@ -201,7 +204,8 @@ void convertPosition(const Position& P, tb_pos& out) {
         out.castling |= TB_CASTLING_q;
 }
 
-bool EndgameDB::probe_next_move(const Position &p, Move &move_out, int &dtz_out) {
+bool EndgameDB::probe_next_move(const Board &p, Move &move_out, int &dtz_out) {
+    if (!initialized) return false;
     tb_pos pos;
     convertPosition(p, pos);
 
@@ -233,25 +237,58 @@ bool EndgameDB::probe_next_move(const Position &p, Move &move_out, int &dtz_out)
     int from = TB_GET_FROM(res);
     int to = TB_GET_TO(res);
 
-    move_out = Move(Square(from), Square(to));
+    // promotions carry the piece; whether they capture is left to the caller's move list
+    static const MoveFlags promotions[] = {QUIET, PR_QUEEN, PR_ROOK, PR_BISHOP, PR_KNIGHT};
+    move_out = Move(Square(from), Square(to), promotions[TB_GET_PROMOTES(res)]);
 
     return true;
 }
 
-bool EndgameDB::probe_wdl(const Position &pos, int &result) {
-    return false;
+bool EndgameDB::probe_wdl(const Board &p, int &result) {
+    if (!initialized) return false;
+    stats::count(stats::TB_PROBES);
+
+    // the zobrist key does not cover the en passant square, which changes the result
+    Square ep = p.history[p.ply()].epsq;
+    uint64_t key = p.get_hash() ^ (ep == NO_SQUARE ? 0 : (uint64_t(ep) + 1) * 0x9E3779B97F4A7C15ULL);
+    std::atomic<uint64_t> &slot = wdlCache[key & (WDL_CACHE_SIZE - 1)];
+    uint64_t cached = slot.load(std::memory_order_relaxed);
+    if ((cached & ~7ULL) == (key & ~7ULL) && (cached & 7)) {
+        result = int(cached & 7) - 3;
+        tbHits.fetch_add(1, std::memory_order_relaxed);
+        stats::count(stats::TB_HITS);
+        return true;
+    }
+
+    tb_pos pos;
+    convertPosition(p, pos);
+    unsigned res = tb_probe_wdl(pos.white, pos.black, pos.kings,
+        pos.queens, pos.rooks, pos.bishops, pos.knights, pos.pawns,
+        pos.rule50, pos.castling, pos.ep, pos.turn);
+    if (res == TB_RESULT_FAILED) return false;
+
+    // TB_LOSS .. TB_WIN are 0 .. 4
+    result = int(res) - 2;
+    slot.store((key & ~7ULL) | uint64_t(result + 3), std::memory_order_relaxed);
+    tbHits.fetch_add(1, std::memory_order_relaxed);
+    stats::count(stats::TB_HITS);
+    return true;
 }
 
 
-EndgameDB::EndgameDB() : initialized(false) {}
+EndgameDB::EndgameDB() : initialized(false), wdlCache(std::make_unique<std::atomic<uint64_t>[]>(WDL_CACHE_SIZE)) {}
 
 void EndgameDB::load(const std::string& path) {
-    // TODO: implement actual tablebase loading
-    // For now consider non-empty path as "loaded"
-    initialized = !path.empty();
+    // tb_init with an empty path releases the tables that were loaded before
+    initialized = tb_init(path.c_str()) && TB_LARGEST > 0;
+    for (size_t i = 0; i < WDL_CACHE_SIZE; ++i) wdlCache[i].store(0, std::memory_order_relaxed);
+}
+
+int EndgameDB::max_pieces() const {
+    return initialized ? int(TB_LARGEST) : 0;
 }
 
-bool EndgameDB::probe_dtz(const Position& /*pos*/, int& /*result*/) {
+bool EndgameDB::probe_dtz(const Board& /*pos*/, int& /*result*/) {
     // TODO: implement DTZ probe against loaded tablebases
     return false;
 }
\ No newline at end of file
@@ -8,6 +8,10 @@
 #pragma once
 
 #include "../lib/surge/src/position.h"
+#include "Board.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
 #include <string>
 
 class EndgameDB {
@@ -15,13 +19,36 @@ public:
     EndgameDB();
 
     void load(const std::string& path);
-    bool probe_next_move(const Position &p, Move &move, int &dtz);
-    bool probe_dtz(const Position& pos, int& result);
-    bool probe_wdl(const Position& pos, int& result);
+    // Best root move: from, to and the promotion piece (PR_* flags) are set, other flags are not
+    bool probe_next_move(const Board &p, Move &move, int &dtz);
+    bool probe_dtz(const Board& pos, int& result);
+
+    // Win/draw/loss of the side to move: 2 win, 1 cursed win (a win the 50-move rule turns into a draw),
+    // 0 draw, -1 blessed loss, -2 loss. Only works right after a capture or pawn move and without castling
+    // rights, as the tables assume both. Safe to call from any number of search threads.
+    bool probe_wdl(const Board& pos, int& result);
     bool available() const { return initialized; }
 
+    // Most pieces, kings included, of the loaded tables
+    int max_pieces() const;
+
+    // Positions with as many pieces as the largest tables are only probed at this depth or deeper
+    int probe_depth() const { return probeDepth; }
+    void set_probe_depth(int depth) { probeDepth = depth; }
+
+    // Successful WDL probes since the last reset
+    uint64_t hits() const { return tbHits.load(std::memory_order_relaxed); }
+    void reset_hits() { tbHits.store(0, std::memory_order_relaxed); }
+
 private:
     bool initialized;
+    int probeDepth = 1;
+    std::atomic<uint64_t> tbHits{0};
+
+    // Results of recent probes. Each slot is one word: the upper bits of the key and the result in the low
+    // three bits, so a slot is always read whole and needs no lock.
+    static constexpr size_t WDL_CACHE_SIZE = 1 << 16;
+    std::unique_ptr<std::atomic<uint64_t>[]> wdlCache;
 };
 
 #endif //CHESS_ENDGAMEDB_H
\ No newline at end of file
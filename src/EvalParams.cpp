@@ -0,0 +1,316 @@
+//
+// Created by fabian on 10/18/26.
+//
+
+#include "EvalParams.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <numeric>
+#include <sstream>
+#include <vector>
+
+// The piece-square tables the evaluation was written with, drawn like a diagram from White's side: the
+// first row is rank 8, files a to h. The values are scaled into the parameters below.
+static const int pawn_table[64] = {
+    0,  0,  0,  0,  0,  0,  0,  0,
+   50, 50, 50, 50, 50, 50, 50, 50,
+   10, 10, 20, 30, 30, 20, 10, 10,
+    5,  5, 10, 25, 25, 10,  5,  5,
+    0,  5,  5, 20, 20,  5,  5,  5,
+    5,  5,  0,  0,  0,  0,  5,  5,
+    5,  5, 10,-20,-20, 10,  5,  5,
+    0,  0,  0,  0,  0,  0,  0,  0
+};
+
+static const int knight_table[64] = {
+    -50,-40,-30,-30,-30,-30,-40,-50,
+    -40,-20,  0,  5,  5,  0,-20,-40,
+    -30,  5, 10, 15, 15, 10,  5,-30,
+    -30,  0, 15, 20, 20, 15,  0,-30,
+    -30,  5, 15, 20, 20, 15,  5,-30,
+    -30,  0, 10, 15, 15, 10,  0,-30,
+    -40,-20,  0,  0,  0,  0,-20,-40,
+    -50,-40,-30,-30,-30,-30,-40,-50
+};
+
+static const int bishop_table[64] = {
+    -20,  0,  0,  0,  0,  0,  0,-20,
+      0, 10,  0,  5,  5,  0, 10,  0,
+      5,  0,  0,  5,  5,  0,  0,  5,
+      0,  0,  5,  0,  0,  5,  0,  0,
+      0,  5,  0,  0,  0,  0,  5,  0,
+      0,  0,  0,  0,  0,  0,  0,  5,
+      0, 10,  0,  5,  5,  0,  10, 0,
+    -20,  0,  0,  0,  0, -20,  0,-20
+};
+
+static const int rook_table[64] = {
+      5,  5,  5,  5,  5,  5,  5,  5,
+      0,  0,  0,  0,  0,  0,  0,  0,
+      0,  0,  0,  0,  0,  0,  0,  0,
+      0,  0,  0,  0,  0,  0,  0,  0,
+      0,  0,  0,  0,  0,  0,  0,  0,
+      0,  0,  0,  0,  0,  0,  0,  0,
+      0,  0,  0,  0,  0,  0,  0,  0,
+      5,  5,  5,  5,  5,  5,  5,  5,
+};
+
+static const int queen_table[64] = {
+    0,  5,  5,  0,  0,  5,  5,  0,
+    5,  5,  5,  0,  0,  5,  5,  5,
+    5,  5,  5,  0,  0,  5,  5,  5,
+    0,  0,  0,  0,  0,  0,  0,  0,
+    0,  0,  0,  0,  0,  0,  0,  0,
+    5,  5,  5,  0,  0,  5,  5,  5,
+    5,  5,  5,  0,  0,  5,  5,  5,
+    0,  5,  5,  0,  0,  5,  5,  0,
+};
+
+static const int king_table[64] = {
+    0,  0,  0,  0,  0,  0,  0,  0,
+    0,  0,  0,  0,  0,  0,  0,  0,
+    0,  0,  0,  0,  0,  0,  0,  0,
+    0,  0,  0,  0,  0,  0,  0,  0,
+    0,  0,  0,  0,  0,  0,  0,  0,
+    0,  0,  0,  0,  0,  0,  0,  0,
+    0,  0,  0,  0,  0,  0,  0,  0,
+    5, 40, 40,  0,  0,  5, 80,  5,
+};
+
+// Without queens and most pieces the king belongs in the centre. In centipawns, unlike the tables above.
+static const int king_endgame_table[64] = {
+    -50,-30,-20,-10,-10,-20,-30,-50,
+    -30,-10,  0,  5,  5,  0,-10,-30,
+    -20,  0, 15, 20, 20, 15,  0,-20,
+    -10,  5, 20, 30, 30, 20,  5,-10,
+    -10,  5, 20, 30, 30, 20,  5,-10,
+    -20,  0, 15, 20, 20, 15,  0,-20,
+    -30,-10,  0,  5,  5,  0,-10,-30,
+    -50,-30,-20,-10,-10,-20,-30,-50,
+};
+
+const EvalParams &default_eval_params() {
+    static const EvalParams params = [] {
+        EvalParams p{};
+        // pawns gain against the pieces in the endgame, the rook against the minors
+        const int mg[NPIECE_TYPES] = {1000, 3200, 3300, 5000, 9000, 0};
+        const int eg[NPIECE_TYPES] = {1200, 3000, 3300, 5200, 9300, 0};
+        for (int pt = PAWN; pt <= KING; ++pt) p.material[pt] = S(mg[pt], eg[pt]);
+
+        const int *tables[NPIECE_TYPES] = {pawn_table, knight_table, bishop_table, rook_table, queen_table, king_table};
+        for (int pt = PAWN; pt <= KING; ++pt) {
+            for (int sq = 0; sq < 64; ++sq) {
+                // the diagram's first row is rank 8
+                const int t = sq ^ 56;
+                const int v = tables[pt][t];
+                p.psqt[pt][sq] = pt == KING ? S(v * 2 / 5, king_endgame_table[t] * 10) : S(v / 5, v / 5);
+            }
+        }
+
+        // A passed pawn is worth far more once the pieces that could stop it are gone, weak pawns are
+        // harder to defend in the endgame
+        const EvalPair passed[8] = {
+            S(0, 0), S(5, 40), S(10, 80), S(20, 150), S(35, 250), S(60, 450), S(100, 750), S(0, 0)
+        };
+        const EvalPair connected[8] = {
+            S(0, 0), S(3, 3), S(4, 4), S(5, 6), S(7, 10), S(10, 20), S(15, 30), S(0, 0)
+        };
+        for (int r = 0; r < 8; ++r) {
+            p.passed[r] = passed[r];
+            p.connected[r] = connected[r];
+        }
+        p.isolated = S(-10, -20);
+        p.doubled = S(-10, -20);
+        p.backward = S(-8, -10);
+
+        const EvalPair defended[NPIECE_TYPES] = {S(2, 2), S(4, 4), S(4, 4), S(4, 4), S(2, 2), 0};
+        // minors hurt most, then rooks, then pawns, queens least
+        const EvalPair pinned[NPIECE_TYPES] = {S(-5, -5), S(-10, -10), S(-10, -10), S(-7, -7), S(-4, -4), 0};
+        // squares count more in the endgame, where the pieces have room to use them
+        const EvalPair mobility[NPIECE_TYPES] = {0, S(1, 2), S(1, 2), S(0, 1), 0, 0};
+        // by the value at stake, a little less than pinned pieces since a threat can still be answered
+        const EvalPair threatened[NPIECE_TYPES] = {S(-3, -3), S(-8, -8), S(-8, -8), S(-10, -10), S(-12, -12), 0};
+        for (int pt = PAWN; pt <= KING; ++pt) {
+            p.defended[pt] = defended[pt];
+            p.pinned[pt] = pinned[pt];
+            p.mobility[pt] = mobility[pt];
+            p.threatened[pt] = threatened[pt];
+        }
+
+        // king safety only matters while there are pieces to attack the king
+        p.kingShieldMissing = S(-2, 0);
+        p.kingLineAttacker[BISHOP] = S(-6, 0);
+        p.kingLineAttacker[ROOK] = S(-6, 0);
+        p.kingLineAttacker[QUEEN] = S(-9, 0);
+        p.kingAttackerNear = S(-2, 0);
+        p.kingZoneAttacked = S(-2, 0);
+        p.kingZoneWeak = S(-4, 0);
+        return p;
+    }();
+    return params;
+}
+
+EvalParams eval_params;
+uint64_t eval_params_key = 0;
+int eval_lazy_margin = 0;
+int eval_king_margin = 0;
+EvalPair PSQT[NPIECES][NSQUARES];
+
+// Pieces of a side in the starting position, and the most squares each of them can attack (for pawns, all
+// of them together). The margins count no more pieces than that: once promotions add some, the material
+// is rarely close enough for the positional terms to decide.
+static constexpr int START_COUNT[NPIECE_TYPES] = {8, 2, 2, 2, 1, 1};
+static constexpr int MAX_ATTACKS[NPIECE_TYPES] = {16, 8, 13, 14, 27, 8};
+
+struct TermBounds {
+    int all;    // every term after the pawn structure
+    int king;   // king safety alone
+};
+
+// Every term is a sum of weight * (White's count - Black's count), with both counts between 0 and a most,
+// so weight * most bounds it. half picks the midgame or endgame values; the blend of the two by game phase
+// stays within the larger bound.
+static TermBounds term_bounds(const EvalParams &p, int (*half)(EvalPair)) {
+    auto w = [&](const EvalPair &v) { return std::abs(half(v)); };
+
+    int defended = 0, mobility = 0, threatened = 0;
+    // the king zone has nine squares at most
+    int king = 3 * w(p.kingShieldMissing) + 9 * (w(p.kingZoneAttacked) + w(p.kingZoneWeak));
+    std::vector<int> pins;
+    for (int pt = PAWN; pt <= QUEEN; ++pt) {
+        defended += START_COUNT[pt] * w(p.defended[pt]);
+        mobility += (pt == PAWN ? 1 : START_COUNT[pt]) * MAX_ATTACKS[pt] * w(p.mobility[pt]);
+        threatened += START_COUNT[pt] * w(p.threatened[pt]);
+        pins.insert(pins.end(), START_COUNT[pt], w(p.pinned[pt]));
+        if (pt >= BISHOP) king += START_COUNT[pt] * (w(p.kingLineAttacker[pt]) + 3 * w(p.kingAttackerNear));
+    }
+    // a king has eight lines to pin along, the pieces with the largest weights are the worst case
+    std::sort(pins.begin(), pins.end(), std::greater<>());
+    const int pinned = std::accumulate(pins.begin(), pins.begin() + 8, 0);
+
+    return {defended + pinned + mobility + threatened + king, king};
+}
+
+void apply_eval_params(const EvalParams &p) {
+    eval_params = p;
+
+    for (int pc = 0; pc < int(NPIECES); ++pc) {
+        for (int sq = 0; sq < 64; ++sq) {
+            PSQT[pc][sq] = 0;
+            if (pc == NO_PIECE || (pc & 0b111) > KING) continue;
+
+            const Piece piece = Piece(pc);
+            const PieceType pt = type_of(piece);
+            const EvalPair v = p.material[pt] + p.psqt[pt][psqt_square(color_of(piece), sq)];
+            PSQT[pc][sq] = color_of(piece) == WHITE ? v : -v;
+        }
+    }
+
+    // +1 for the rounding of the phase blend, which partial and full scores do separately
+    const TermBounds mg = term_bounds(p, mg_value), eg = term_bounds(p, eg_value);
+    eval_lazy_margin = std::max(mg.all, eg.all) + 1;
+    eval_king_margin = std::max(mg.king, eg.king) + 1;
+
+    // FNV-1a over the weights
+    uint64_t key = 0xcbf29ce484222325ULL;
+    for (const EvalPair *v = p.begin(); v != p.begin() + EVAL_PARAM_COUNT; ++v) {
+        key = (key ^ uint64_t(*v)) * 0x100000001b3ULL;
+    }
+    eval_params_key = key;
+}
+
+static const bool eval_params_initialised = [] {
+    apply_eval_params(default_eval_params());
+    return true;
+}();
+
+struct ParamField {
+    const char *name;
+    size_t offset;      // in pairs
+    size_t count;
+    size_t rowLength;   // pairs per row of a two-dimensional field, 0 for a flat one
+};
+
+#define PARAM_FIELD(field, rowLength) \
+    {#field, offsetof(EvalParams, field) / sizeof(EvalPair), sizeof(EvalParams::field) / sizeof(EvalPair), rowLength}
+
+static const ParamField FIELDS[] = {
+    PARAM_FIELD(material, 0),
+    PARAM_FIELD(psqt, NSQUARES),
+    PARAM_FIELD(passed, 0),
+    PARAM_FIELD(connected, 0),
+    PARAM_FIELD(isolated, 0),
+    PARAM_FIELD(doubled, 0),
+    PARAM_FIELD(backward, 0),
+    PARAM_FIELD(defended, 0),
+    PARAM_FIELD(pinned, 0),
+    PARAM_FIELD(mobility, 0),
+    PARAM_FIELD(threatened, 0),
+    PARAM_FIELD(kingShieldMissing, 0),
+    PARAM_FIELD(kingLineAttacker, 0),
+    PARAM_FIELD(kingAttackerNear, 0),
+    PARAM_FIELD(kingZoneAttacked, 0),
+    PARAM_FIELD(kingZoneWeak, 0),
+};
+
+#undef PARAM_FIELD
+
+std::string eval_param_name(size_t index) {
+    for (const ParamField &f : FIELDS) {
+        if (index < f.offset || index >= f.offset + f.count) continue;
+        const size_t i = index - f.offset;
+        if (f.count == 1) return f.name;
+        if (f.rowLength) return std::string(f.name) + "[" + std::to_string(i / f.rowLength) + "][" + std::to_string(i % f.rowLength) + "]";
+        return std::string(f.name) + "[" + std::to_string(i) + "]";
+    }
+    return "?";
+}
+
+bool load_eval_params(const std::string &filename, EvalParams &p) {
+    std::ifstream in(filename);
+    if (!in) return false;
+
+    // only a complete file changes p
+    EvalParams loaded = p;
+    std::string token;
+    while (in >> token) {
+        if (token[0] == '#') {
+            std::getline(in, token);
+            continue;
+        }
+        const ParamField *field = nullptr;
+        for (const ParamField &f : FIELDS) {
+            if (token == f.name) field = &f;
+        }
+        if (!field) return false;
+
+        for (size_t i = 0; i < field->count; ++i) {
+            int mg, eg;
+            if (!(in >> mg >> eg)) return false;
+            loaded.begin()[field->offset + i] = S(mg, eg);
+        }
+    }
+    p = loaded;
+    return true;
+}
+
+bool save_eval_params(const std::string &filename, const EvalParams &p) {
+    std::ofstream out(filename);
+    if (!out) return false;
+
+    out << "# Wombat evaluation parameters: every field name is followed by the midgame and endgame\n"
+        << "# value of each of its pairs\n";
+    for (const ParamField &f : FIELDS) {
+        out << f.name;
+        // eight pairs to a line, a board rank of the piece-square tables
+        for (size_t i = 0; i < f.count; ++i) {
+            const EvalPair v = p.begin()[f.offset + i];
+            out << (i % 8 == 0 ? "\n   " : "   ") << " " << mg_value(v) << " " << eg_value(v);
+        }
+        out << "\n";
+    }
+    return bool(out);
+}
@@ -0,0 +1,107 @@
+//
+// Created by fabian on 10/18/26.
+//
+
+#ifndef CHESS_EVALPARAMS_H
+#define CHESS_EVALPARAMS_H
+
+#pragma once
+
+#include "../lib/surge/src/types.h"
+#include "psqt.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Every weight of the classical evaluation, as midgame/endgame pairs in the units of evaluate(). A score
+// is the sum of weight * count over the features of a position, from the point of view of the side that
+// has them, so bonuses are positive and penalties negative. The tuner (util/tune.cpp) fits them to game
+// results; the engine loads its output with the EvalParams option.
+struct EvalParams {
+    EvalPair material[NPIECE_TYPES];                // the king has none
+    EvalPair psqt[NPIECE_TYPES][NSQUARES];          // as White's pieces read them, a1 first; see psqt_square
+
+    // pawn structure, by relative rank where there are eight values
+    EvalPair passed[8];
+    EvalPair connected[8];
+    EvalPair isolated;
+    EvalPair doubled;
+    EvalPair backward;
+
+    EvalPair defended[NPIECE_TYPES];                // a piece attacked by an own piece other than the king
+    EvalPair pinned[NPIECE_TYPES];                  // a piece pinned to its own king
+    EvalPair mobility[NPIECE_TYPES];                // per attacked square not occupied by an own piece
+    EvalPair threatened[NPIECE_TYPES];              // a piece the enemy attacks more often than it is defended
+
+    // king safety
+    EvalPair kingShieldMissing;                     // per missing pawn on the three squares in front of the king
+    EvalPair kingLineAttacker[NPIECE_TYPES];        // an enemy slider attacking the king's square
+    EvalPair kingAttackerNear;                      // per square that such a slider is closer than 3 squares
+    EvalPair kingZoneAttacked;                      // per square around the king the enemy attacks
+    EvalPair kingZoneWeak;                          // per square around the king attacked twice, defended once
+
+    EvalPair *begin() { return reinterpret_cast<EvalPair *>(this); }
+    const EvalPair *begin() const { return reinterpret_cast<const EvalPair *>(this); }
+};
+
+// Number of pairs, the struct holds nothing else
+constexpr size_t EVAL_PARAM_COUNT = sizeof(EvalParams) / sizeof(EvalPair);
+
+// Index into EvalParams::psqt for a piece of colour c on sq: Black reads White's tables mirrored by rank
+constexpr int psqt_square(Color c, int sq) {
+    return c == WHITE ? sq : sq ^ 56;
+}
+
+// The hand-picked values the evaluation started from
+const EvalParams &default_eval_params();
+
+// The weights evaluate() reads. Change them through apply_eval_params only.
+extern EvalParams eval_params;
+
+// Changes with every set of weights applied; caches of evaluation results mix it into their keys so that
+// scores of other weights never match
+extern uint64_t eval_params_key;
+
+// Makes p the weights of the evaluation and rebuilds what is derived from them: the PSQT and the margins
+// below. Boards set up before keep their old material sums until they are set again.
+void apply_eval_params(const EvalParams &p);
+
+// Most that the terms after the pawn structure (defended pieces, pins, mobility, king safety) and the king
+// safety term alone can move an evaluation, for the weights applied. The evaluation stops early when a
+// partial score is further than that outside the search window.
+extern int eval_lazy_margin;
+extern int eval_king_margin;
+
+// Text files of "name" followed by the mg and eg value of every pair of that field, separated by any white
+// space. Fields the file does not name keep the values they had.
+bool load_eval_params(const std::string &filename, EvalParams &p);
+bool save_eval_params(const std::string &filename, const EvalParams &p);
+
+// Name of the field a pair belongs to and its position in it, for printing ("psqt[3][17]")
+std::string eval_param_name(size_t index);
+
+// How often each pair contributes to the evaluation of one position, White's minus Black's. The classical
+// evaluation is linear in the weights apart from the game phase blend, so the tapered sum of count * pair
+// over all pairs reproduces its score.
+struct EvalTrace {
+    int16_t counts[EVAL_PARAM_COUNT] = {};
+
+    void add(Color c, const EvalPair &param, int n = 1) {
+        counts[&param - eval_params.begin()] += c == WHITE ? n : -n;
+    }
+};
+
+// Stands in for EvalTrace when nothing is traced, and compiles to nothing
+struct NoTrace {
+    void add(Color, const EvalPair &, int = 1) {}
+};
+
+// count * param, as a term of the evaluation of side c
+template<typename Trace>
+inline EvalPair weigh(Trace &trace, Color c, const EvalPair &param, int count = 1) {
+    trace.add(c, param, count);
+    return count * param;
+}
+
+#endif //CHESS_EVALPARAMS_H
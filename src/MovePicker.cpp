@@ -0,0 +1,45 @@
+//
+// Created by fabian on 10/18/26.
+//
+
+#include "MovePicker.h"
+
+#include <cstring>
+#include <cstdlib>
+
+void MoveHistory::clear() {
+    std::memset(butterfly, 0, sizeof(butterfly));
+    for (auto &c : counterMoves) for (auto &m : c) m = Move();
+    for (auto &m : played) m = Move();
+    clear_killers();
+}
+
+void MoveHistory::clear_killers() {
+    for (auto &k : killers) {
+        k[0] = Move();
+        k[1] = Move();
+    }
+}
+
+void MoveHistory::update_quiet(Color us, const Position &p, Move best, const Move *tried, int nTried, int depth) {
+    // history gravity: entries saturate at HISTORY_MAX instead of growing without bound
+    auto update = [&](Move m, int bonus) {
+        int &e = butterfly[us][m.from()][m.to()];
+        e += bonus - e * std::abs(bonus) / HISTORY_MAX;
+    };
+
+    int bonus = std::min(depth * depth, 400);
+    update(best, bonus);
+    for (int i = 0; i < nTried; ++i) {
+        if (tried[i] != best) update(tried[i], -bonus);
+    }
+
+    int ply = ply_index(p.ply());
+    if (killers[ply][0] != best) {
+        killers[ply][1] = killers[ply][0];
+        killers[ply][0] = best;
+    }
+
+    Move prev = played[ply];
+    if (prev != Move() && p.at(prev.to()) != NO_PIECE) counterMoves[p.at(prev.to())][prev.to()] = best;
+}
@@ -0,0 +1,216 @@
+//
+// Created by fabian on 10/18/26.
+//
+
+#ifndef CHESS_MOVEPICKER_H
+#define CHESS_MOVEPICKER_H
+
+#pragma once
+
+#include "../lib/surge/src/position.h"
+#include "eval.h"
+#include "see.h"
+
+// Move ordering statistics of one search thread. Every thread owns its own instance, so they are
+// updated without any synchronisation.
+struct MoveHistory {
+    static constexpr int MAX_PLY = 256;
+    static constexpr int HISTORY_MAX = 16384;
+
+    int butterfly[NCOLORS][NSQUARES][NSQUARES];   // quiet move history, indexed by [side][from][to]
+    Move killers[MAX_PLY][2];                     // quiet moves that caused a cutoff at this ply
+    Move counterMoves[NPIECES][NSQUARES];         // refutation of the previous move, by its piece and target
+    Move played[MAX_PLY];                         // move that led to the position at this ply
+
+    void clear();
+    void clear_killers();
+
+    static int ply_index(int ply) { return ply & (MAX_PLY - 1); }
+
+    // Rewards the quiet move that caused a beta cutoff and punishes the quiets tried before it
+    void update_quiet(Color us, const Position &p, Move best, const Move *tried, int nTried, int depth);
+};
+
+// Returns the moves of a node one at a time, roughly best first, in stages:
+// TT move, good captures (MVV-LVA, SEE >= 0), killers, countermove, quiets by history, bad captures.
+// Moves are only scored once their stage is reached and picked by a partial selection sort,
+// so a node that cuts off early never orders the rest of its moves.
+template<Color Us>
+class MovePicker {
+public:
+    // Main search: all legal moves
+    MovePicker(Position &p, const MoveHistory &h, Move ttMove)
+        : p(p), h(h), ttMove(ttMove), capturesOnly(false) {
+        int ply = MoveHistory::ply_index(p.ply());
+        killer1 = h.killers[ply][0];
+        killer2 = h.killers[ply][1];
+        Move prev = h.played[ply];
+        if (prev != Move() && p.at(prev.to()) != NO_PIECE) counter = h.counterMoves[p.at(prev.to())][prev.to()];
+        generate();
+    }
+
+    // Quiescence search: captures and queen promotions that do not lose material
+    MovePicker(Position &p, const MoveHistory &h)
+        : p(p), h(h), capturesOnly(true) {
+        generate();
+    }
+
+    // Number of legal moves in the position (including the ones that are not returned in capture mode)
+    int size() const { return legalCount; }
+
+    // Returns the next move, or Move() once all moves have been returned
+    Move next() {
+        switch (stage) {
+            case TT_MOVE:
+                stage = GOOD_CAPTURES;
+                if (take_capture(ttMove) || take_quiet(ttMove)) return ttMove;
+                [[fallthrough]];
+            case GOOD_CAPTURES:
+                while (current < captureEnd) {
+                    int i = best_index(current, captureEnd);
+                    if (scores[i] < GOOD_CAPTURE) break;
+                    return pop(i);
+                }
+                // quiescence does not search captures that lose material
+                if (capturesOnly) {
+                    stage = DONE;
+                    return Move();
+                }
+                stage = KILLER1;
+                [[fallthrough]];
+            case KILLER1:
+                stage = KILLER2;
+                if (killer1 != ttMove && take_quiet(killer1)) return killer1;
+                [[fallthrough]];
+            case KILLER2:
+                stage = COUNTER;
+                if (killer2 != ttMove && take_quiet(killer2)) return killer2;
+                [[fallthrough]];
+            case COUNTER:
+                stage = SCORE_QUIETS;
+                if (counter != ttMove && counter != killer1 && counter != killer2
+                    && take_quiet(counter)) return counter;
+                [[fallthrough]];
+            case SCORE_QUIETS:
+                for (int i = quietBegin; i < quietEnd; ++i) {
+                    scores[i] = h.butterfly[Us][moves[i].from()][moves[i].to()];
+                }
+                stage = QUIETS;
+                [[fallthrough]];
+            case QUIETS:
+                if (quietBegin < quietEnd) {
+                    int i = best_index(quietBegin, quietEnd);
+                    Move m = moves[i];
+                    moves[i] = moves[quietBegin];
+                    scores[i] = scores[quietBegin];
+                    quietBegin++;
+                    return m;
+                }
+                stage = BAD_CAPTURES;
+                [[fallthrough]];
+            case BAD_CAPTURES:
+                if (current < captureEnd) return pop(best_index(current, captureEnd));
+                stage = DONE;
+                [[fallthrough]];
+            case DONE:
+            default:
+                return Move();
+        }
+    }
+
+    static constexpr int GOOD_CAPTURE = 1 << 24;
+
+private:
+    enum Stage {
+        TT_MOVE, GOOD_CAPTURES, KILLER1, KILLER2, COUNTER, SCORE_QUIETS, QUIETS, BAD_CAPTURES, DONE
+    };
+
+    Position &p;
+    const MoveHistory &h;
+    Move ttMove, killer1, killer2, counter;
+    bool capturesOnly;
+    Stage stage = TT_MOVE;
+
+    // moves[0, captureEnd) hold captures and promotions, moves[quietBegin, quietEnd) the quiets
+    Move moves[218];
+    int scores[218];
+    int legalCount = 0;
+    int current = 0;
+    int captureEnd = 0;
+    int quietBegin = 0;
+    int quietEnd = 0;
+
+    // Move::is_capture() is also true for pushes, castling and promotions, so test the capture bit itself
+    static bool is_tactical(Move m) {
+        return (m.flags() & CAPTURE) || m.flags() == PR_QUEEN;
+    }
+
+    void generate() {
+        Move *last = p.generate_legals<Us>(moves);
+        legalCount = int(last - moves);
+
+        // captures and queen promotions to the front, the quiets stay behind them
+        for (int i = 0; i < legalCount; ++i) {
+            if (is_tactical(moves[i])) {
+                Move m = moves[i];
+                moves[i] = moves[captureEnd];
+                moves[captureEnd] = m;
+                scores[captureEnd] = score_capture(m);
+                captureEnd++;
+            }
+        }
+        quietBegin = captureEnd;
+        quietEnd = capturesOnly ? captureEnd : legalCount;
+    }
+
+    // MVV-LVA; captures that lose material by static exchange go to the bad captures
+    int score_capture(Move m) const {
+        Piece attacker = p.at(m.from());
+        int victim = m.flags() == EN_PASSANT ? piece_value(make_piece(~Us, PAWN)) : piece_value(p.at(m.to()));
+        int promo = (m.flags() == PR_QUEEN || m.flags() == PC_QUEEN) ? piece_value(make_piece(Us, QUEEN)) : 0;
+        int score = (victim + promo) * 8 - type_of(attacker);
+
+        return see_ge(p, m, 0) ? score + GOOD_CAPTURE : score;
+    }
+
+    int best_index(int begin, int end) const {
+        int best = begin;
+        for (int i = begin + 1; i < end; ++i) {
+            if (scores[i] > scores[best]) best = i;
+        }
+        return best;
+    }
+
+    Move pop(int i) {
+        Move m = moves[i];
+        moves[i] = moves[current];
+        scores[i] = scores[current];
+        current++;
+        return m;
+    }
+
+    // Removes m from the captures or the quiets if it is still there; used for moves returned ahead of their stage
+    bool take_capture(Move m) {
+        if (m == Move()) return false;
+        for (int i = current; i < captureEnd; ++i) {
+            if (moves[i] == m) {
+                pop(i);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool take_quiet(Move m) {
+        if (m == Move()) return false;
+        for (int i = quietBegin; i < quietEnd; ++i) {
+            if (moves[i] == m) {
+                moves[i] = moves[quietBegin++];
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+#endif //CHESS_MOVEPICKER_H
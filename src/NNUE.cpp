@@ -0,0 +1,418 @@
+//
+// Created by fabian on 10/18/26.
+//
+
+#include "NNUE.h"
+#include "eval.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define NNUE_X86
+#endif
+
+NNUE nnue;
+
+static constexpr uint32_t NNUE_VERSION = 0x7AF32F16;
+static constexpr int WEIGHT_SCALE_BITS = 6;    // hidden layer outputs are scaled by 2^6
+static constexpr int OUTPUT_SCALE = 16;        // network output units per internal unit of the trainer
+static constexpr int TRAINER_PAWN = 208;       // value of a pawn in the trainer's units
+static constexpr int MAX_CHANGES = 4 * 256;
+
+// ---------------------------------------------------------------------------------------------------------------
+// SIMD kernels. Every kernel is built for AVX2, SSE4.1 and plain C++; the best one the CPU supports is picked
+// the first time a kernel is needed, so one binary runs everywhere.
+
+// dst = src + sum(add) - sum(sub), all of length NNUE::HALF_DIMS; dst may equal src
+using UpdateFn = void (*)(int16_t *dst, const int16_t *src,
+                          const int16_t *const *add, int nAdd, const int16_t *const *sub, int nSub);
+// out[i] = clamp(in[i], 0, 127)
+using ClipFn = void (*)(const int16_t *in, uint8_t *out, int n);
+// sum of in[i] * w[i]; n is a multiple of 32
+using DotFn = int32_t (*)(const uint8_t *in, const int8_t *w, int n);
+
+static void update_scalar(int16_t *dst, const int16_t *src,
+                          const int16_t *const *add, int nAdd, const int16_t *const *sub, int nSub) {
+    for (int i = 0; i < NNUE::HALF_DIMS; ++i) {
+        int16_t v = src[i];
+        for (int a = 0; a < nAdd; ++a) v += add[a][i];
+        for (int s = 0; s < nSub; ++s) v -= sub[s][i];
+        dst[i] = v;
+    }
+}
+
+static void clip_scalar(const int16_t *in, uint8_t *out, int n) {
+    for (int i = 0; i < n; ++i) out[i] = uint8_t(std::clamp<int>(in[i], 0, 127));
+}
+
+static int32_t dot_scalar(const uint8_t *in, const int8_t *w, int n) {
+    int32_t sum = 0;
+    for (int i = 0; i < n; ++i) sum += int32_t(in[i]) * w[i];
+    return sum;
+}
+
+#ifdef NNUE_X86
+
+__attribute__((target("avx2")))
+static void update_avx2(int16_t *dst, const int16_t *src,
+                        const int16_t *const *add, int nAdd, const int16_t *const *sub, int nSub) {
+    // 64 values (four registers) per pass, so every weight row is read exactly once
+    for (int i = 0; i < NNUE::HALF_DIMS; i += 64) {
+        __m256i v0 = _mm256_loadu_si256((const __m256i *) (src + i));
+        __m256i v1 = _mm256_loadu_si256((const __m256i *) (src + i + 16));
+        __m256i v2 = _mm256_loadu_si256((const __m256i *) (src + i + 32));
+        __m256i v3 = _mm256_loadu_si256((const __m256i *) (src + i + 48));
+        for (int a = 0; a < nAdd; ++a) {
+            const int16_t *w = add[a] + i;
+            v0 = _mm256_add_epi16(v0, _mm256_loadu_si256((const __m256i *) w));
+            v1 = _mm256_add_epi16(v1, _mm256_loadu_si256((const __m256i *) (w + 16)));
+            v2 = _mm256_add_epi16(v2, _mm256_loadu_si256((const __m256i *) (w + 32)));
+            v3 = _mm256_add_epi16(v3, _mm256_loadu_si256((const __m256i *) (w + 48)));
+        }
+        for (int s = 0; s < nSub; ++s) {
+            const int16_t *w = sub[s] + i;
+            v0 = _mm256_sub_epi16(v0, _mm256_loadu_si256((const __m256i *) w));
+            v1 = _mm256_sub_epi16(v1, _mm256_loadu_si256((const __m256i *) (w + 16)));
+            v2 = _mm256_sub_epi16(v2, _mm256_loadu_si256((const __m256i *) (w + 32)));
+            v3 = _mm256_sub_epi16(v3, _mm256_loadu_si256((const __m256i *) (w + 48)));
+        }
+        _mm256_storeu_si256((__m256i *) (dst + i), v0);
+        _mm256_storeu_si256((__m256i *) (dst + i + 16), v1);
+        _mm256_storeu_si256((__m256i *) (dst + i + 32), v2);
+        _mm256_storeu_si256((__m256i *) (dst + i + 48), v3);
+    }
+}
+
+__attribute__((target("avx2")))
+static void clip_avx2(const int16_t *in, uint8_t *out, int n) {
+    const __m256i zero = _mm256_setzero_si256();
+    for (int i = 0; i < n; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i *) (in + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *) (in + i + 16));
+        // packs works per 128-bit lane, the permute puts the quadwords back in order
+        __m256i packed = _mm256_max_epi8(_mm256_packs_epi16(a, b), zero);
+        _mm256_storeu_si256((__m256i *) (out + i), _mm256_permute4x64_epi64(packed, 0xD8));
+    }
+}
+
+__attribute__((target("avx2")))
+static int32_t dot_avx2(const uint8_t *in, const int8_t *w, int n) {
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256i sum = _mm256_setzero_si256();
+    for (int i = 0; i < n; i += 32) {
+        // inputs are at most 127, so a pair of products cannot saturate the 16-bit sums
+        __m256i p = _mm256_maddubs_epi16(_mm256_loadu_si256((const __m256i *) (in + i)),
+                                         _mm256_loadu_si256((const __m256i *) (w + i)));
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(p, ones));
+    }
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4E));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+    return _mm_cvtsi128_si32(s);
+}
+
+__attribute__((target("sse4.1")))
+static void update_sse41(int16_t *dst, const int16_t *src,
+                         const int16_t *const *add, int nAdd, const int16_t *const *sub, int nSub) {
+    for (int i = 0; i < NNUE::HALF_DIMS; i += 32) {
+        __m128i v0 = _mm_loadu_si128((const __m128i *) (src + i));
+        __m128i v1 = _mm_loadu_si128((const __m128i *) (src + i + 8));
+        __m128i v2 = _mm_loadu_si128((const __m128i *) (src + i + 16));
+        __m128i v3 = _mm_loadu_si128((const __m128i *) (src + i + 24));
+        for (int a = 0; a < nAdd; ++a) {
+            const int16_t *w = add[a] + i;
+            v0 = _mm_add_epi16(v0, _mm_loadu_si128((const __m128i *) w));
+            v1 = _mm_add_epi16(v1, _mm_loadu_si128((const __m128i *) (w + 8)));
+            v2 = _mm_add_epi16(v2, _mm_loadu_si128((const __m128i *) (w + 16)));
+            v3 = _mm_add_epi16(v3, _mm_loadu_si128((const __m128i *) (w + 24)));
+        }
+        for (int s = 0; s < nSub; ++s) {
+            const int16_t *w = sub[s] + i;
+            v0 = _mm_sub_epi16(v0, _mm_loadu_si128((const __m128i *) w));
+            v1 = _mm_sub_epi16(v1, _mm_loadu_si128((const __m128i *) (w + 8)));
+            v2 = _mm_sub_epi16(v2, _mm_loadu_si128((const __m128i *) (w + 16)));
+            v3 = _mm_sub_epi16(v3, _mm_loadu_si128((const __m128i *) (w + 24)));
+        }
+        _mm_storeu_si128((__m128i *) (dst + i), v0);
+        _mm_storeu_si128((__m128i *) (dst + i + 8), v1);
+        _mm_storeu_si128((__m128i *) (dst + i + 16), v2);
+        _mm_storeu_si128((__m128i *) (dst + i + 24), v3);
+    }
+}
+
+__attribute__((target("sse4.1")))
+static void clip_sse41(const int16_t *in, uint8_t *out, int n) {
+    const __m128i zero = _mm_setzero_si128();
+    for (int i = 0; i < n; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *) (in + i));
+        __m128i b = _mm_loadu_si128((const __m128i *) (in + i + 8));
+        _mm_storeu_si128((__m128i *) (out + i), _mm_max_epi8(_mm_packs_epi16(a, b), zero));
+    }
+}
+
+__attribute__((target("sse4.1")))
+static int32_t dot_sse41(const uint8_t *in, const int8_t *w, int n) {
+    const __m128i ones = _mm_set1_epi16(1);
+    __m128i sum = _mm_setzero_si128();
+    for (int i = 0; i < n; i += 16) {
+        __m128i p = _mm_maddubs_epi16(_mm_loadu_si128((const __m128i *) (in + i)),
+                                      _mm_loadu_si128((const __m128i *) (w + i)));
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(p, ones));
+    }
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+    return _mm_cvtsi128_si32(sum);
+}
+
+#endif
+
+struct Kernels {
+    UpdateFn update;
+    ClipFn clip;
+    DotFn dot;
+    const char *name;
+};
+
+static Kernels select_kernels() {
+#ifdef NNUE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return {update_avx2, clip_avx2, dot_avx2, "avx2"};
+    if (__builtin_cpu_supports("sse4.1")) return {update_sse41, clip_sse41, dot_sse41, "sse4.1"};
+#endif
+    return {update_scalar, clip_scalar, dot_scalar, "scalar"};
+}
+
+static const Kernels &kernels() {
+    static const Kernels k = select_kernels();
+    return k;
+}
+
+const char *NNUE::simd_name() {
+    return kernels().name;
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+// Loading
+
+NNUE::~NNUE() {
+    unmap();
+}
+
+void NNUE::unmap() {
+    if (mapping) munmap(mapping, mappingSize);
+    mapping = nullptr;
+    mappingSize = 0;
+    ftBiases = ftWeights = nullptr;
+    ftCopy.clear();
+}
+
+template<typename T>
+static T read_le(const unsigned char *&p) {
+    T v;
+    std::memcpy(&v, p, sizeof(T));
+    p += sizeof(T);
+    return v;
+}
+
+bool NNUE::load(const std::string &path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || st.st_size < 12) {
+        close(fd);
+        return false;
+    }
+    size_t size = size_t(st.st_size);
+    void *map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return false;
+
+    // header: version, architecture hash, description; then the feature transformer and the hidden layers,
+    // each preceded by a hash of its layout
+    const auto *base = static_cast<const unsigned char *>(map);
+    const unsigned char *p = base;
+    uint32_t version = read_le<uint32_t>(p);
+    read_le<uint32_t>(p);
+    uint32_t descLength = read_le<uint32_t>(p);
+
+    size_t expected = 12 + size_t(descLength) + 4 + sizeof(int16_t) * (HALF_DIMS + size_t(HALF_DIMS) * INPUT_DIMS)
+                      + 4 + sizeof(int32_t) * L1_DIMS + L1_DIMS * 2 * HALF_DIMS
+                      + sizeof(int32_t) * L2_DIMS + L2_DIMS * L1_DIMS
+                      + sizeof(int32_t) + L2_DIMS;
+    if (version != NNUE_VERSION || size != expected) {
+        munmap(map, size);
+        return false;
+    }
+
+    unmap();
+    mapping = map;
+    mappingSize = size;
+    madvise(map, size, MADV_WILLNEED);
+
+    p += descLength + 4;
+    const unsigned char *ft = p;
+    size_t ftBytes = sizeof(int16_t) * (HALF_DIMS + size_t(HALF_DIMS) * INPUT_DIMS);
+    if (reinterpret_cast<uintptr_t>(ft) % alignof(int16_t) == 0) {
+        ftBiases = reinterpret_cast<const int16_t *>(ft);
+    } else {
+        // an odd-length description leaves the weights misaligned, fall back to a private copy
+        ftCopy.resize(ftBytes / sizeof(int16_t));
+        std::memcpy(ftCopy.data(), ft, ftBytes);
+        ftBiases = ftCopy.data();
+    }
+    ftWeights = ftBiases + HALF_DIMS;
+    p += ftBytes + 4;
+
+    std::memcpy(b1, p, sizeof(b1)); p += sizeof(b1);
+    std::memcpy(w1, p, sizeof(w1)); p += sizeof(w1);
+    std::memcpy(b2, p, sizeof(b2)); p += sizeof(b2);
+    std::memcpy(w2, p, sizeof(w2)); p += sizeof(w2);
+    std::memcpy(&bOut, p, sizeof(bOut)); p += sizeof(bOut);
+    std::memcpy(wOut, p, sizeof(wOut));
+    ++generation;
+    return true;
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+// Accumulators
+
+// Index of the feature (king square of c, piece, square) as seen from side c; black's view is rotated
+static inline int feature_index(Color c, Square ksq, Piece pc, Square sq) {
+    const int flip = c == WHITE ? 0 : 63;
+    const int piece = 1 + (2 * type_of(pc) + (color_of(pc) != c)) * 64;
+    return (int(sq) ^ flip) + piece + 641 * (int(ksq) ^ flip);
+}
+
+static inline bool is_feature(Piece pc) {
+    return pc != NO_PIECE && type_of(pc) != KING;
+}
+
+// One stack per thread, indexed like Board's states. An entry is only trusted if its key matches the
+// position at the same index and it was computed by the current network, so entries left behind by other
+// searches, other boards or an earlier network are harmless.
+NNUE::Accumulator *NNUE::accumulator_stack() {
+    static thread_local std::unique_ptr<Accumulator[]> stack;
+    if (!stack) stack = std::make_unique<Accumulator[]>(256);
+    return stack.get();
+}
+
+void NNUE::refresh_perspective(const Board &b, Color c, int16_t *out) const {
+    const Square ksq = bsf(b.bitboard_of(c, KING));
+    const int16_t *add[32];
+    int nAdd = 0;
+    Bitboard pieces = b.all_pieces<WHITE>() | b.all_pieces<BLACK>();
+    while (pieces) {
+        Square sq = pop_lsb(&pieces);
+        if (is_feature(b.at(sq))) add[nAdd++] = ftWeights + size_t(feature_index(c, ksq, b.at(sq), sq)) * HALF_DIMS;
+    }
+    kernels().update(out, ftBiases, add, nAdd, nullptr, 0);
+}
+
+void NNUE::update_accumulator(const Board &b, Accumulator *stack) const {
+    const int top = b.state_index();
+    if (is_current(stack[top], b, top)) return;
+
+    // nearest earlier position on this board whose accumulator is still there
+    int base = top - 1;
+    while (base >= 0 && !is_current(stack[base], b, base)) --base;
+    if (base < 0) {
+        refresh_perspective(b, WHITE, stack[top].values[WHITE]);
+        refresh_perspective(b, BLACK, stack[top].values[BLACK]);
+        stack[top].key = b.state(top).key;
+        stack[top].net = generation;
+        return;
+    }
+
+    // a king move changes every feature of its own side, so that side is recomputed instead
+    int firstKingMove = top + 1;
+    bool kingMoved[NCOLORS] = {false, false};
+    for (int k = base + 1; k <= top; ++k) {
+        const Board::BoardState &st = b.state(k);
+        for (int i = 0; i < st.nChanged; ++i) {
+            if (st.removed[i] != NO_PIECE && type_of(st.removed[i]) == KING) {
+                kingMoved[color_of(st.removed[i])] = true;
+                firstKingMove = std::min(firstKingMove, k);
+            }
+        }
+    }
+
+    const Square ksq[NCOLORS] = {bsf(b.bitboard_of(WHITE, KING)), bsf(b.bitboard_of(BLACK, KING))};
+    auto collect = [&](Color c, int from, int to, const int16_t **add, int &nAdd, const int16_t **sub, int &nSub) {
+        for (int k = from; k <= to; ++k) {
+            const Board::BoardState &st = b.state(k);
+            for (int i = 0; i < st.nChanged; ++i) {
+                if (is_feature(st.removed[i]))
+                    sub[nSub++] = ftWeights + size_t(feature_index(c, ksq[c], st.removed[i], st.changed[i])) * HALF_DIMS;
+                if (is_feature(st.added[i]))
+                    add[nAdd++] = ftWeights + size_t(feature_index(c, ksq[c], st.added[i], st.changed[i])) * HALF_DIMS;
+            }
+        }
+    };
+
+    const int16_t *add[MAX_CHANGES], *sub[MAX_CHANGES];
+
+    // up to the first king move every position on the way is filled in, siblings further down reuse them
+    for (int k = base + 1; k < firstKingMove; ++k) {
+        for (Color c : {WHITE, BLACK}) {
+            int nAdd = 0, nSub = 0;
+            collect(c, k, k, add, nAdd, sub, nSub);
+            kernels().update(stack[k].values[c], stack[k - 1].values[c], add, nAdd, sub, nSub);
+        }
+        stack[k].key = b.state(k).key;
+        stack[k].net = generation;
+    }
+    if (firstKingMove > top) return;
+
+    for (Color c : {WHITE, BLACK}) {
+        if (kingMoved[c]) {
+            refresh_perspective(b, c, stack[top].values[c]);
+        } else {
+            int nAdd = 0, nSub = 0;
+            collect(c, firstKingMove, top, add, nAdd, sub, nSub);
+            kernels().update(stack[top].values[c], stack[firstKingMove - 1].values[c], add, nAdd, sub, nSub);
+        }
+    }
+    stack[top].key = b.state(top).key;
+    stack[top].net = generation;
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+// Inference
+
+template<Color Us>
+int NNUE::evaluate(const Board &b) const {
+    Accumulator *stack = accumulator_stack();
+    update_accumulator(b, stack);
+    const Accumulator &acc = stack[b.state_index()];
+    const Kernels &k = kernels();
+
+    alignas(64) uint8_t input[2 * HALF_DIMS];
+    alignas(64) uint8_t hidden1[L1_DIMS];
+    alignas(64) uint8_t hidden2[L2_DIMS];
+
+    // side to move first
+    k.clip(acc.values[Us], input, HALF_DIMS);
+    k.clip(acc.values[~Us], input + HALF_DIMS, HALF_DIMS);
+
+    for (int o = 0; o < L1_DIMS; ++o) {
+        int32_t v = b1[o] + k.dot(input, w1 + o * 2 * HALF_DIMS, 2 * HALF_DIMS);
+        hidden1[o] = uint8_t(std::clamp(v >> WEIGHT_SCALE_BITS, 0, 127));
+    }
+    for (int o = 0; o < L2_DIMS; ++o) {
+        int32_t v = b2[o] + k.dot(hidden1, w2 + o * L1_DIMS, L1_DIMS);
+        hidden2[o] = uint8_t(std::clamp(v >> WEIGHT_SCALE_BITS, 0, 127));
+    }
+    int32_t out = bOut + k.dot(hidden2, wOut, L2_DIMS);
+
+    return int(int64_t(out) * piece_value(WHITE_PAWN) / (OUTPUT_SCALE * TRAINER_PAWN));
+}
+
+template int NNUE::evaluate<WHITE>(const Board &b) const;
+template int NNUE::evaluate<BLACK>(const Board &b) const;
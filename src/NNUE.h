@@ -0,0 +1,87 @@
+//
+// Created by fabian on 10/18/26.
+//
+
+#ifndef CHESS_NNUE_H
+#define CHESS_NNUE_H
+
+#pragma once
+
+#include "../lib/surge/src/types.h"
+#include "Board.h"
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Efficiently updatable neural network evaluation.
+// The network is the HalfKP 41024 -> 2x256 -> 32 -> 32 -> 1 architecture, read from the .nnue file format
+// Stockfish 12 introduced: a feature is (own king square, piece, square) for every piece but the kings,
+// seen from both sides. The first layer is kept per position as two 256-wide accumulators, which follow
+// Board::play/undo incrementally; only a king move forces its side's accumulator to be recomputed.
+class NNUE {
+public:
+    static constexpr int HALF_DIMS = 256;
+    static constexpr int INPUT_DIMS = 64 * 641;
+    static constexpr int L1_DIMS = 32;
+    static constexpr int L2_DIMS = 32;
+
+    NNUE() = default;
+    ~NNUE();
+    NNUE(const NNUE &) = delete;
+    NNUE &operator=(const NNUE &) = delete;
+
+    // Maps the network file into memory. Returns false (and keeps the previous network) if the file
+    // cannot be opened or is not a HalfKP network.
+    bool load(const std::string &path);
+    bool available() const { return ftWeights != nullptr; }
+    // Changes with every network loaded, for caches of its scores
+    uint32_t network_id() const { return generation; }
+
+    // Static evaluation from the side to move's point of view, in the units of evaluate()
+    template<Color Us>
+    int evaluate(const Board &b) const;
+
+    // Name of the SIMD kernels chosen for this CPU: "avx2", "sse4.1" or "scalar"
+    static const char *simd_name();
+
+private:
+    struct alignas(64) Accumulator {
+        int16_t values[NCOLORS][HALF_DIMS];
+        uint64_t key = 0;   // hash of the position the values belong to, 0 if not computed
+        uint32_t net = 0;   // generation of the network that computed them
+    };
+
+    // counts the networks loaded, so that the accumulators of an earlier one are recomputed
+    uint32_t generation = 0;
+
+    // mapped file
+    void *mapping = nullptr;
+    size_t mappingSize = 0;
+
+    // first layer, used in place from the mapping unless the file leaves it misaligned
+    const int16_t *ftBiases = nullptr;
+    const int16_t *ftWeights = nullptr;
+    std::vector<int16_t> ftCopy;
+
+    // the small hidden layers are copied out of the file into aligned storage
+    alignas(64) int32_t b1[L1_DIMS];
+    alignas(64) int8_t w1[L1_DIMS * 2 * HALF_DIMS];
+    alignas(64) int32_t b2[L2_DIMS];
+    alignas(64) int8_t w2[L2_DIMS * L1_DIMS];
+    int32_t bOut;
+    alignas(64) int8_t wOut[L2_DIMS];
+
+    void unmap();
+    static Accumulator *accumulator_stack();
+
+    bool is_current(const Accumulator &a, const Board &b, int i) const {
+        return a.key == b.state(i).key && a.net == generation;
+    }
+    void update_accumulator(const Board &b, Accumulator *stack) const;
+    void refresh_perspective(const Board &b, Color c, int16_t *out) const;
+};
+
+extern NNUE nnue;
+
+#endif //CHESS_NNUE_H
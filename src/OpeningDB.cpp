@@ -4,8 +4,178 @@
 
 #include "OpeningDB.h"
 #include <fstream>
-#include <sstream>
 #include <iostream>
 #include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-using namespace std;
\ No newline at end of file
+using namespace std;
+
+static uint64_t read_be(const unsigned char *p, int bytes) {
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; ++i) v = (v << 8) | p[i];
+    return v;
+}
+
+static void write_be(unsigned char *p, uint64_t v, int bytes) {
+    for (int i = bytes - 1; i >= 0; --i) {
+        p[i] = uint8_t(v);
+        v >>= 8;
+    }
+}
+
+OpeningDB::~OpeningDB() {
+    unmap();
+}
+
+void OpeningDB::unmap() {
+    if (mapping) munmap(const_cast<unsigned char *>(mapping), mappingSize);
+    mapping = nullptr;
+    mappingSize = 0;
+    records = 0;
+}
+
+bool OpeningDB::load(const string &filename) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || st.st_size == 0 || st.st_size % RECORD_SIZE != 0) {
+        close(fd);
+        return false;
+    }
+    size_t size = size_t(st.st_size);
+    void *map = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return false;
+
+    unmap();
+    mapping = static_cast<const unsigned char *>(map);
+    mappingSize = size;
+    records = size / RECORD_SIZE;
+    // probes jump around the whole file
+    madvise(map, size, MADV_RANDOM);
+    return true;
+}
+
+uint64_t OpeningDB::key_at(size_t i) const {
+    return read_be(mapping + i * RECORD_SIZE, 8);
+}
+
+BookEntry OpeningDB::entry_at(size_t i) const {
+    return read_record(mapping + i * RECORD_SIZE);
+}
+
+BookEntry OpeningDB::read_record(const unsigned char *p) {
+    BookEntry e;
+    e.key = read_be(p, 8);
+    e.move = uint16_t(read_be(p + 8, 2));
+    e.weight = uint16_t(read_be(p + 10, 2));
+    e.count = uint32_t(read_be(p + 12, 4));
+    return e;
+}
+
+void OpeningDB::write_record(unsigned char *p, const BookEntry &e) {
+    write_be(p, e.key, 8);
+    write_be(p + 8, e.move, 2);
+    write_be(p + 10, e.weight, 2);
+    write_be(p + 12, e.count, 4);
+}
+
+// Index of the first record with a key >= key. Zobrist keys are spread evenly, so interpolating between
+// the keys at the ends of the range lands next to the target after a few steps; should the keys ever be
+// skewed, it falls back to bisection.
+size_t OpeningDB::lower_bound(uint64_t key) const {
+    size_t lo = 0, hi = records;
+    for (int step = 0; hi - lo > 8; ++step) {
+        uint64_t kl = key_at(lo), kh = key_at(hi - 1);
+        if (key <= kl) return lo;
+        if (key > kh) return hi;
+
+        size_t mid;
+        if (step < 4) {
+            long double fraction = (long double)(key - kl) / (long double)(kh - kl);
+            mid = lo + size_t(fraction * (hi - 1 - lo));
+        } else {
+            mid = lo + (hi - lo) / 2;
+        }
+        mid = clamp(mid, lo + 1, hi - 1);
+
+        if (key_at(mid) < key) lo = mid + 1;
+        else hi = mid;
+    }
+    while (lo < hi && key_at(lo) < key) ++lo;
+    return lo;
+}
+
+vector<BookEntry> OpeningDB::entries(uint64_t key) const {
+    vector<BookEntry> out;
+    if (!mapping) return out;
+    for (size_t i = lower_bound(key); i < records && key_at(i) == key; ++i) out.push_back(entry_at(i));
+    return out;
+}
+
+uint16_t OpeningDB::encode_move(Move m) {
+    Square to = m.to();
+    // surge already writes short castling as king takes rook, long castling goes to c1/c8
+    if (m.flags() == OOO) to = m.from() == e1 ? a1 : a8;
+    int promotion = (m.flags() & PR_KNIGHT) ? (m.flags() & 0b11) + 1 : 0;
+    return uint16_t(to | (m.from() << 6) | (promotion << 12));
+}
+
+template<Color Us>
+static vector<pair<Move, int>> legal_book_moves(Position &pos, const vector<BookEntry> &entries) {
+    vector<pair<Move, int>> moves;
+    MoveList<Us> legal(pos);
+    for (const BookEntry &e : entries) {
+        if (e.weight == 0) continue;
+        // a key collision with another position must not produce an illegal move
+        for (Move m : legal) {
+            if (OpeningDB::encode_move(m) == e.move) {
+                moves.emplace_back(m, e.weight);
+                break;
+            }
+        }
+    }
+    return moves;
+}
+
+bool OpeningDB::probe(Position &pos, Move &move) {
+    vector<BookEntry> found = entries(pos.get_hash());
+    if (found.empty()) return false;
+
+    vector<pair<Move, int>> moves = pos.turn() == WHITE ? legal_book_moves<WHITE>(pos, found)
+                                                        : legal_book_moves<BLACK>(pos, found);
+    if (moves.empty()) return false;
+
+    // Weighted random selection
+    int total = 0;
+    for (auto &m : moves) total += m.second;
+    uniform_int_distribution<int> dist(1, total);
+    int r = dist(rng);
+
+    for (auto &m : moves) {
+        r -= m.second;
+        if (r <= 0) {
+            move = m.first;
+            return true;
+        }
+    }
+    move = moves.back().first;
+    return true;
+}
+
+bool OpeningDB::write(const string &filename, vector<BookEntry> &entries) {
+    // by key, and the most played move of a position first, like Polyglot books
+    sort(entries.begin(), entries.end(), [](const BookEntry &a, const BookEntry &b) {
+        return a.key != b.key ? a.key < b.key : a.weight > b.weight;
+    });
+
+    ofstream ofs(filename, ios::binary);
+    if (!ofs) return false;
+    vector<unsigned char> buffer(entries.size() * RECORD_SIZE);
+    for (size_t i = 0; i < entries.size(); ++i) write_record(buffer.data() + i * RECORD_SIZE, entries[i]);
+    ofs.write(reinterpret_cast<const char *>(buffer.data()), streamsize(buffer.size()));
+    return bool(ofs);
+}
@@ -7,118 +7,68 @@
 
 #pragma once
 
-#include <string>
-#include <vector>
-#include <unordered_map>
+#include <cstddef>
+#include <cstdint>
 #include <random>
-#include "../lib/surge/src/position.h"
-
-#include <iostream>
-#include <fstream>
-#include <sstream>
-#include <unordered_map>
 #include <string>
 #include <vector>
-#include <random>
+#include "../lib/surge/src/position.h"
 
 using namespace std;
 
-struct PositionEntry {
-    string move1;
-    int move1_count = 0;
-    string move2;
-    int move2_count = 0;
-    string move3;
-    int move3_count = 0;
-    int total_occurrences = 0;
+// One book move. On disk every entry is a 16-byte record in the layout of a Polyglot book: key, move,
+// weight and a 32-bit field that Polyglot leaves to the user and we use for the raw game count, all
+// big-endian, sorted by key. The key is surge's zobrist hash of the position.
+struct BookEntry {
+    uint64_t key = 0;
+    uint16_t move = 0;      // Polyglot encoding, see OpeningDB::encode_move
+    uint16_t weight = 0;    // relative probability of playing the move
+    uint32_t count = 0;     // number of games in which the move was played
 };
 
+// Opening book, memory-mapped read-only: loading costs nothing beyond the mmap call, and several engine
+// processes using the same book share its pages.
 class OpeningDB {
-private:
-    unordered_map<uint64_t, PositionEntry> db;
-    mt19937 rng;
-
 public:
+    static constexpr size_t RECORD_SIZE = 16;
+
     OpeningDB() : rng(random_device{}()) {}
+    ~OpeningDB();
+    OpeningDB(const OpeningDB &) = delete;
+    OpeningDB &operator=(const OpeningDB &) = delete;
+
+    // Maps a book written by write(). On failure the previously loaded book, if any, stays in use.
+    bool load(const string &filename);
+
+    // Picks one of the legal book moves of pos at random, weighted by the entry weights
+    bool probe(Position &pos, Move &move);
+
+    // All entries of the book for the given key
+    vector<BookEntry> entries(uint64_t key) const;
+
+    size_t size() const { return records; }
+
+    // Sorts the entries and writes them as a book
+    static bool write(const string &filename, vector<BookEntry> &entries);
+
+    // One record in the on-disk layout, RECORD_SIZE bytes
+    static BookEntry read_record(const unsigned char *p);
+    static void write_record(unsigned char *p, const BookEntry &e);
+
+    // Polyglot move encoding: to square in bits 0-5, from square in bits 6-11, promotion piece
+    // (1 knight .. 4 queen) in bits 12-14. Castling is written as the king capturing its own rook.
+    static uint16_t encode_move(Move m);
 
-    bool load_from_csv(const string &filename) {
-        ifstream file(filename);
-        if (!file.is_open()) return false;
-
-        string line;
-        getline(file, line); // skip header
-
-        while (getline(file, line)) {
-            stringstream ss(line);
-            string token;
-            PositionEntry entry;
-
-            // Hash
-            getline(ss, token, ',');
-            uint64_t hash = stoull(token);
-
-            // Total occurrences
-            getline(ss, token, ',');
-            entry.total_occurrences = stoi(token);
-
-            // Move1
-            if (getline(ss, token, ',')) entry.move1 = token;
-            if (getline(ss, token, ',')) entry.move1_count = token.empty() ? 0 : stoi(token);
-
-            // Move2
-            if (getline(ss, token, ',')) entry.move2 = token;
-            if (getline(ss, token, ',')) entry.move2_count = token.empty() ? 0 : stoi(token);
-
-            // Move3
-            if (getline(ss, token, ',')) entry.move3 = token;
-            if (getline(ss, token, ',')) entry.move3_count = token.empty() ? 0 : stoi(token);
-
-            db[hash] = entry;
-        }
-
-        return true;
-    }
-
-    // Probe method: returns a random move weighted by count
-    bool probe(const Position pos, Move &move) {
-        auto pos_hash = pos.get_hash();
-        auto it = db.find(pos_hash);
-        if (it == db.end()) {
-            return false;
-        }
-
-        const PositionEntry &entry = it->second;
-
-        vector<pair<string, int>> moves;
-        if (entry.move1_count > 0) moves.push_back({entry.move1, entry.move1_count});
-        if (entry.move2_count > 0) moves.push_back({entry.move2, entry.move2_count});
-        if (entry.move3_count > 0) moves.push_back({entry.move3, entry.move3_count});
-
-        if (moves.empty()) return "";
-
-        // Weighted random selection
-        int total = 0;
-        for (auto &m : moves) total += m.second;
-        uniform_int_distribution<int> dist(1, total);
-        int r = dist(rng);
-
-        for (auto &m : moves) {
-            r -= m.second;
-            if (r <= 0) {
-                move = parse_move(m.first);
-                return true;
-            }
-        }
-
-        move = parse_move(moves.back().first);
-        return true;
-    }
 private:
-    Move parse_move(string uci) {
-        Square from = create_square(File(uci[0] - 'a'), Rank(uci[1] - '1'));
-        Square to = create_square(File(uci[2] - 'a'), Rank(uci[3] - '1'));
-        return Move(from, to);
-    }
+    const unsigned char *mapping = nullptr;
+    size_t mappingSize = 0;
+    size_t records = 0;
+    mt19937 rng;
+
+    uint64_t key_at(size_t i) const;
+    BookEntry entry_at(size_t i) const;
+    size_t lower_bound(uint64_t key) const;
+    void unmap();
 };
 
-#endif //CHESS_OPENINGDB_H
\ No newline at end of file
+#endif //CHESS_OPENINGDB_H
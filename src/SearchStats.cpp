@@ -0,0 +1,132 @@
+//
+// Created by fabian on 10/18/26.
+//
+
+#include "SearchStats.h"
+
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace stats {
+
+#ifdef WOMBAT_STATS
+static std::mutex blocksMutex;
+static std::vector<std::unique_ptr<ThreadCounters>> blocks;
+static std::vector<ThreadCounters *> freeBlocks;
+
+// gives the block of a thread back when the thread ends
+struct Release {
+    ~Release() {
+        if (!current) return;
+        std::lock_guard<std::mutex> lock(blocksMutex);
+        current->depth = 0;
+        freeBlocks.push_back(current);
+    }
+};
+static thread_local Release release;
+
+ThreadCounters *acquire() {
+    (void)&release;   // odr-use, so that the thread registers its destructor
+    std::lock_guard<std::mutex> lock(blocksMutex);
+    if (!freeBlocks.empty()) {
+        ThreadCounters *t = freeBlocks.back();
+        freeBlocks.pop_back();
+        return t;
+    }
+    blocks.push_back(std::make_unique<ThreadCounters>());
+    return blocks.back().get();
+}
+#endif
+
+void reset() {
+#ifdef WOMBAT_STATS
+    std::lock_guard<std::mutex> lock(blocksMutex);
+    for (auto &t : blocks) {
+        for (auto &row : t->counts) {
+            for (auto &n : row) n.store(0, std::memory_order_relaxed);
+        }
+    }
+#endif
+}
+
+Totals collect() {
+    Totals totals;
+#ifdef WOMBAT_STATS
+    std::lock_guard<std::mutex> lock(blocksMutex);
+    for (auto &t : blocks) {
+        for (int d = 0; d < MAX_STATS_DEPTH; ++d) {
+            for (int c = 0; c < COUNTER_NB; ++c) totals.counts[d][c] += t->counts[d][c].load(std::memory_order_relaxed);
+        }
+    }
+#endif
+    return totals;
+}
+
+uint64_t Totals::total(Counter c) const {
+    uint64_t n = 0;
+    for (auto &row : counts) n += row[c];
+    return n;
+}
+
+Totals &Totals::operator+=(const Totals &o) {
+    for (int d = 0; d < MAX_STATS_DEPTH; ++d) {
+        for (int c = 0; c < COUNTER_NB; ++c) counts[d][c] += o.counts[d][c];
+    }
+    return *this;
+}
+
+static double percent(uint64_t part, uint64_t whole) {
+    return whole ? 100.0 * double(part) / double(whole) : 0.0;
+}
+
+static const char *const COLUMNS[COUNTER_NB] = {
+    "nodes", "qnodes", "ttprobe", "tthit", "ttstore", "ttover", "cutoff", "1stcut",
+    "nulltry", "nullcut", "futility", "lmp", "eval", "evalhit", "tbprobe", "tbhit"
+};
+
+void print(std::ostream &os, const Totals &totals) {
+    if (!ENABLED) {
+        os << "statistics are not compiled in, build with -DWOMBAT_STATS=ON" << std::endl;
+        return;
+    }
+
+    os << std::setw(5) << "depth";
+    for (const char *name : COLUMNS) os << std::setw(12) << name;
+    os << "\n";
+    for (int d = MAX_STATS_DEPTH - 1; d >= 0; --d) {
+        bool any = false;
+        for (uint64_t n : totals.counts[d]) any |= n != 0;
+        if (!any) continue;
+        os << std::setw(5) << d;
+        for (uint64_t n : totals.counts[d]) os << std::setw(12) << n;
+        os << "\n";
+    }
+    os << std::setw(5) << "all";
+    for (int c = 0; c < COUNTER_NB; ++c) os << std::setw(12) << totals.total(Counter(c));
+    os << "\n\n";
+
+    os << std::fixed << std::setprecision(1)
+       << "TT hit rate          : " << percent(totals.total(TT_HITS), totals.total(TT_PROBES)) << " %\n"
+       << "TT overwrites        : " << percent(totals.total(TT_OVERWRITES), totals.total(TT_STORES)) << " % of stores\n"
+       << "First move cutoffs   : " << percent(totals.total(FIRST_MOVE_CUTOFFS), totals.total(BETA_CUTOFFS)) << " %\n"
+       << "Null move cutoffs    : " << percent(totals.total(NULL_MOVE_CUTOFFS), totals.total(NULL_MOVE_TRIES)) << " %\n"
+       << "Eval cache hits      : " << percent(totals.total(EVAL_CACHE_HITS), totals.total(EVAL_CALLS) + totals.total(EVAL_CACHE_HITS)) << " %\n"
+       << "Quiescence nodes     : " << percent(totals.total(QNODES), totals.total(NODES) + totals.total(QNODES)) << " %\n"
+       << "TB hit rate          : " << percent(totals.total(TB_HITS), totals.total(TB_PROBES)) << " %" << std::endl;
+    os << std::defaultfloat;
+}
+
+void print_summary(std::ostream &os, const Totals &totals) {
+    os << std::fixed << std::setprecision(1)
+       << "tthit " << percent(totals.total(TT_HITS), totals.total(TT_PROBES))
+       << "% firstcut " << percent(totals.total(FIRST_MOVE_CUTOFFS), totals.total(BETA_CUTOFFS))
+       << "% nullcut " << percent(totals.total(NULL_MOVE_CUTOFFS), totals.total(NULL_MOVE_TRIES))
+       << "% qnodes " << totals.total(QNODES) << " evals " << totals.total(EVAL_CALLS)
+       << " evalhits " << totals.total(EVAL_CACHE_HITS)
+       << " futility " << totals.total(FUTILITY_PRUNES) << " lmp " << totals.total(LMP_PRUNES)
+       << std::defaultfloat;
+}
+
+}
@@ -0,0 +1,116 @@
+//
+// Created by fabian on 10/18/26.
+//
+
+#ifndef CHESS_SEARCHSTATS_H
+#define CHESS_SEARCHSTATS_H
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+// Counters of what happens in the search, by remaining depth. Built with -DWOMBAT_STATS (the CMake option
+// of the same name) only: otherwise every hook below is an empty inline function and compiles to nothing.
+//
+// Each thread increments its own block of counters, aligned to cache lines so that threads never write
+// to the same line. The blocks are only summed up when somebody asks for the totals.
+namespace stats {
+
+#ifdef WOMBAT_STATS
+inline constexpr bool ENABLED = true;
+#else
+inline constexpr bool ENABLED = false;
+#endif
+
+enum Counter {
+    NODES,              // alpha-beta nodes
+    QNODES,             // quiescence nodes
+    TT_PROBES,
+    TT_HITS,
+    TT_STORES,
+    TT_OVERWRITES,      // stores that replaced the entry of another position
+    BETA_CUTOFFS,
+    FIRST_MOVE_CUTOFFS, // cutoffs by the first move searched
+    NULL_MOVE_TRIES,
+    NULL_MOVE_CUTOFFS,
+    FUTILITY_PRUNES,
+    LMP_PRUNES,         // late move pruning
+    EVAL_CALLS,
+    EVAL_CACHE_HITS,
+    TB_PROBES,
+    TB_HITS,
+    COUNTER_NB
+};
+
+// Depths from 0 (quiescence) to MAX_STATS_DEPTH - 1; deeper nodes are counted in the last row
+constexpr int MAX_STATS_DEPTH = 32;
+
+struct alignas(64) ThreadCounters {
+    std::atomic<uint64_t> counts[MAX_STATS_DEPTH][COUNTER_NB] = {};
+    int depth = 0;      // remaining depth of the node the thread is in
+};
+
+// Sum over all threads
+struct Totals {
+    std::array<std::array<uint64_t, COUNTER_NB>, MAX_STATS_DEPTH> counts{};
+
+    uint64_t total(Counter c) const;
+    Totals &operator+=(const Totals &o);
+};
+
+#ifdef WOMBAT_STATS
+// The counters of the calling thread, taken from a shared list the first time a thread counts something.
+// Blocks of finished threads are handed to the next new thread, their counts stay in the totals.
+ThreadCounters *acquire();
+inline thread_local ThreadCounters *current = nullptr;
+
+inline ThreadCounters &local() {
+    if (!current) current = acquire();
+    return *current;
+}
+#endif
+
+// One more event at the depth of the current node
+inline void count(Counter c) {
+#ifdef WOMBAT_STATS
+    ThreadCounters &t = local();
+    std::atomic<uint64_t> &n = t.counts[t.depth][c];
+    // only this thread writes the counter, the atomic just makes reading the totals meanwhile well defined
+    n.store(n.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+#endif
+}
+
+// Marks the depth of a node for the events counted inside it (evaluations, table probes) and restores
+// the depth of the parent when the node is left
+class NodeScope {
+public:
+#ifdef WOMBAT_STATS
+    explicit NodeScope(int depth) : parentDepth(local().depth) {
+        local().depth = depth < 0 ? 0 : depth < MAX_STATS_DEPTH ? depth : MAX_STATS_DEPTH - 1;
+    }
+    ~NodeScope() { local().depth = parentDepth; }
+
+private:
+    int parentDepth;
+#else
+    explicit NodeScope(int) {}
+#endif
+};
+
+// Sets every counter of every thread to zero; must not race with a search
+void reset();
+
+Totals collect();
+
+// Table of all counters by depth, followed by the rates derived from them
+void print(std::ostream &os, const Totals &totals);
+
+// One line of the most telling rates, for UCI info strings
+void print_summary(std::ostream &os, const Totals &totals);
+
+}
+
+#endif //CHESS_SEARCHSTATS_H
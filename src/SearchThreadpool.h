@@ -9,66 +9,178 @@
 #include <thread>
 #include <mutex>
 #include <condition_variable>
-#include <queue>
-#include <functional>
 #include <vector>
-#include <future>
+#include <memory>
 #include <atomic>
+#include <chrono>
 
-#include "../lib/surge/src/position.h"
+// A set of tasks that a parent node waits for. Cancelling a group also cancels every group created
+// below it, which is how a beta cutoff at a split point stops the sibling subtrees.
+struct TaskGroup {
+    std::atomic<int> pending{0};
+    std::atomic<bool> cancel{false};
+    TaskGroup *parent = nullptr;
 
-struct SearchResult {
-    int score;
-    Move move;
+    bool cancelled() const {
+        for (const TaskGroup *g = this; g; g = g->parent) {
+            if (g->cancel.load(std::memory_order_relaxed)) return true;
+        }
+        return false;
+    }
+};
+
+// Tasks are owned by the submitting frame (usually on its stack), the pool never allocates or frees them
+struct SearchTask {
+    void (*run)(SearchTask &task) = nullptr;
+    TaskGroup *group = nullptr;
 };
 
+// Work-stealing executor. Every worker owns a deque: it pushes and pops its own tasks at the bottom
+// (LIFO, good locality), while idle threads steal from the top of other deques. Threads outside the pool
+// (the search's main thread) submit to an extra shared deque. A thread that waits for a group keeps
+// executing tasks instead of blocking, so nested waits can never starve the pool.
 class SearchThreadPool {
 public:
-    SearchThreadPool(size_t numThreads) {
-        stop = false;
+    explicit SearchThreadPool(size_t numThreads) : deques(numThreads + 1) {
+        for (auto &d : deques) d = std::make_unique<Deque>();
         for (size_t i = 0; i < numThreads; ++i) {
-            workers.emplace_back([this]() { this->worker(); });
+            workers.emplace_back([this, i]() { this->worker(int(i)); });
         }
     }
 
     ~SearchThreadPool() {
         {
-            std::unique_lock<std::mutex> lock(queueMutex);
+            std::unique_lock<std::mutex> lock(sleepMutex);
             stop = true;
         }
         cv.notify_all();
         for (auto &t : workers) t.join();
     }
 
-    void enqueue(std::packaged_task<void()> task) {
-        {
-            std::unique_lock<std::mutex> lock(queueMutex);
-            tasks.push(std::move(task));  // must move!
+    size_t size() const { return workers.size(); }
+
+    // Queues a task of group g. Returns false if the deque is full; the caller then runs the task itself.
+    bool submit(SearchTask &task, TaskGroup &g) {
+        task.group = &g;
+        g.pending.fetch_add(1, std::memory_order_relaxed);
+        if (!own_deque().push_bottom(&task)) {
+            g.pending.fetch_sub(1, std::memory_order_relaxed);
+            return false;
+        }
+        queued.fetch_add(1, std::memory_order_release);
+        if (sleeping.load(std::memory_order_relaxed) > 0) cv.notify_one();
+        return true;
+    }
+
+    // Help-while-waiting join: runs queued tasks (own ones first) until every task of g has finished
+    void wait(TaskGroup &g) {
+        while (g.pending.load(std::memory_order_acquire) > 0) {
+            SearchTask *task = take();
+            if (task) execute(*task);
+            else std::this_thread::yield();
         }
-        cv.notify_one();
+    }
+
+    // The group of the task the calling thread is currently executing, if any
+    static TaskGroup *current_group() { return currentGroup; }
+
+    static bool cancelled() {
+        return currentGroup && currentGroup->cancelled();
     }
 
 private:
+    static constexpr int DEQUE_SIZE = 1024;
+
+    // Fixed-size ring buffer; the short critical sections are guarded by a per-deque spinlock
+    struct alignas(64) Deque {
+        std::atomic_flag lock = ATOMIC_FLAG_INIT;
+        SearchTask *tasks[DEQUE_SIZE];
+        size_t top = 0, bottom = 0;
+
+        void acquire() { while (lock.test_and_set(std::memory_order_acquire)) std::this_thread::yield(); }
+        void release() { lock.clear(std::memory_order_release); }
+
+        bool push_bottom(SearchTask *t) {
+            acquire();
+            bool ok = bottom - top < DEQUE_SIZE;
+            if (ok) tasks[bottom++ % DEQUE_SIZE] = t;
+            release();
+            return ok;
+        }
+
+        SearchTask *pop_bottom() {
+            acquire();
+            SearchTask *t = bottom > top ? tasks[--bottom % DEQUE_SIZE] : nullptr;
+            release();
+            return t;
+        }
+
+        SearchTask *steal_top() {
+            acquire();
+            SearchTask *t = bottom > top ? tasks[top++ % DEQUE_SIZE] : nullptr;
+            release();
+            return t;
+        }
+    };
+
     std::vector<std::thread> workers;
-    std::queue<std::packaged_task<void()>> tasks;
-    std::mutex queueMutex;
+    std::vector<std::unique_ptr<Deque>> deques;   // one per worker, the last one is shared by outside threads
+    std::atomic<int> queued{0};
+    std::atomic<int> sleeping{0};
+    std::mutex sleepMutex;
     std::condition_variable cv;
-    bool stop;
+    bool stop = false;
+
+    static inline thread_local int workerIndex = -1;
+    static inline thread_local TaskGroup *currentGroup = nullptr;
+
+    Deque &own_deque() {
+        return *deques[workerIndex >= 0 ? workerIndex : deques.size() - 1];
+    }
 
-    void worker() {
+    SearchTask *take() {
+        if (queued.load(std::memory_order_acquire) == 0) return nullptr;
+
+        SearchTask *t = own_deque().pop_bottom();
+        if (!t) {
+            size_t n = deques.size();
+            size_t start = workerIndex >= 0 ? workerIndex + 1 : 0;
+            for (size_t i = 0; i < n && !t; ++i) t = deques[(start + i) % n]->steal_top();
+        }
+        if (t) queued.fetch_sub(1, std::memory_order_relaxed);
+        return t;
+    }
+
+    void execute(SearchTask &task) {
+        TaskGroup *saved = currentGroup;
+        TaskGroup *group = task.group;
+        currentGroup = group;
+        if (!group->cancelled()) task.run(task);
+        currentGroup = saved;
+        // the owner may free the task as soon as pending drops, do not touch it afterwards
+        group->pending.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+    void worker(int index) {
+        workerIndex = index;
         while (true) {
-            std::packaged_task<void()> task;
-            {
-                std::unique_lock<std::mutex> lock(queueMutex);
-                cv.wait(lock, [this]{ return stop || !tasks.empty(); });
-                if (stop && tasks.empty()) return; // exit thread safely
-                task = std::move(tasks.front());
-                tasks.pop();
+            SearchTask *task = take();
+            if (task) {
+                execute(*task);
+                continue;
             }
-            task(); // execute outside lock
+
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            if (stop) return; // exit thread safely
+            sleeping.fetch_add(1, std::memory_order_relaxed);
+            // the timeout covers a submit racing with going to sleep
+            cv.wait_for(lock, std::chrono::milliseconds(1), [this] {
+                return stop || queued.load(std::memory_order_acquire) > 0;
+            });
+            sleeping.fetch_sub(1, std::memory_order_relaxed);
         }
     }
 };
 
 
-#endif //CHESS_SEARCHTHREADPOOL_H
\ No newline at end of file
+#endif //CHESS_SEARCHTHREADPOOL_H
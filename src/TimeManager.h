@@ -0,0 +1,127 @@
+//
+// Created by fabian on 10/18/26.
+//
+
+#ifndef CHESS_TIMEMANAGER_H
+#define CHESS_TIMEMANAGER_H
+
+#pragma once
+
+#include "../lib/surge/src/types.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+
+// What the caller allows a search to use. Zero means "no limit" for every field; a search without any
+// limit runs until it is stopped from outside.
+struct SearchLimits {
+    int depth = 0;                    // maximum iteration depth
+    uint64_t nodes = 0;               // maximum number of nodes, summed over all threads
+    int moveTimeMs = 0;               // fixed time for this move
+    int timeLeftMs[NCOLORS] = {0, 0}; // remaining clock time of each side
+    int incrementMs[NCOLORS] = {0, 0};
+    int movesToGo = 0;                // moves until the next time control, 0 for sudden death
+    bool infinite = false;            // ignore the clock until stopped
+    bool ponder = false;              // searching on the opponent's time, the clock starts at ponderhit
+};
+
+// Turns the limits into two deadlines.
+// The soft deadline is checked between iterations: a new depth is not started once it has passed. It grows
+// when the best move keeps changing or the score drops, since more time pays off most in those positions.
+// The hard deadline is checked inside the search every few nodes and stops it wherever it is.
+class TimeManager {
+public:
+    static constexpr int64_t UNLIMITED = std::numeric_limits<int64_t>::max() / 4;
+    static constexpr int MOVE_OVERHEAD_MS = 30;    // kept in reserve for communication and scheduling delays
+
+    // Starts the clock of a search and whether it ponders. Called by whoever starts the search, before it
+    // may receive a ponderhit, which init must not undo.
+    void start_clock(bool ponder) {
+        start.store(now(), std::memory_order_relaxed);
+        pondering.store(ponder, std::memory_order_relaxed);
+    }
+
+    // Sets the deadlines; the clock runs from start_clock
+    void init(const SearchLimits &limits, Color us, int gamePly) {
+        instability = 0;
+        failLowFactor = 1.0;
+        fixedTime = false;
+        softMs = hardMs = UNLIMITED;
+
+        if (limits.infinite) return;
+
+        if (limits.moveTimeMs > 0) {
+            softMs = hardMs = std::max(1, limits.moveTimeMs - MOVE_OVERHEAD_MS);
+            fixedTime = true;
+            return;
+        }
+
+        const int64_t left = limits.timeLeftMs[us];
+        const int64_t inc = limits.incrementMs[us];
+        if (left <= 0 && inc <= 0) return;
+
+        // sudden death: assume fewer moves remain as the game goes on, but never plan for less than 20
+        int movesLeft = limits.movesToGo > 0 ? std::min(limits.movesToGo, 50)
+                                             : std::max(20, 50 - gamePly / 4);
+        int64_t usable = std::max<int64_t>(1, left - MOVE_OVERHEAD_MS);
+
+        softMs = usable / movesLeft + inc * 3 / 4;
+        // the hard deadline may dip deep into the clock only right before a time control
+        int64_t hardCap = movesLeft == 1 ? usable : usable / 2;
+        hardMs = std::clamp<int64_t>(softMs * 4, 1, hardCap);
+        softMs = std::clamp<int64_t>(softMs, 1, hardMs);
+    }
+
+    int64_t elapsed_ms() const {
+        return now() - start.load(std::memory_order_relaxed);
+    }
+
+    // The opponent played the expected move: from now on the deadlines count, starting from zero
+    void ponderhit() {
+        start.store(now(), std::memory_order_relaxed);
+        pondering.store(false, std::memory_order_relaxed);
+    }
+
+    // Called after every completed iteration with its outcome
+    void update(bool bestMoveChanged, bool scoreDropped) {
+        instability = instability / 2 + (bestMoveChanged ? 1.0 : 0.0);
+        failLowFactor = scoreDropped ? 1.5 : std::max(1.0, failLowFactor * 0.75);
+    }
+
+    // True if no new iteration should be started
+    bool soft_expired() const {
+        if (softMs >= UNLIMITED || pondering.load(std::memory_order_relaxed)) return false;
+        if (fixedTime) return elapsed_ms() >= softMs;
+
+        double scaled = double(softMs) * (1.0 + instability) * failLowFactor;
+        int64_t limit = std::min<int64_t>(hardMs, int64_t(scaled));
+        // an iteration usually takes longer than all the previous ones together, do not start one that cannot finish
+        return elapsed_ms() >= limit / 2;
+    }
+
+    bool hard_expired() const {
+        return hardMs < UNLIMITED && !pondering.load(std::memory_order_relaxed) && elapsed_ms() >= hardMs;
+    }
+
+    int64_t soft_ms() const { return softMs; }
+    int64_t hard_ms() const { return hardMs; }
+
+private:
+    static int64_t now() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // written by the UCI thread on ponderhit while the search threads poll the deadlines
+    std::atomic<int64_t> start{now()};
+    std::atomic<bool> pondering{false};
+    int64_t softMs = UNLIMITED;
+    int64_t hardMs = UNLIMITED;
+    bool fixedTime = false;
+    double instability = 0;
+    double failLowFactor = 1.0;
+};
+
+#endif //CHESS_TIMEMANAGER_H
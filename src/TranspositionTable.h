@@ -6,13 +6,13 @@
 #define CHESS_TRANSPOSITIONTABLE_H
 
 #include "../lib/surge/src/position.h"
-#include <unordered_map>
+#include "SearchStats.h"
+#include <algorithm>
+#include <climits>
 #include <cstdint>
-#include <shared_mutex>
-#include <thread>
+#include <cstddef>
 #include <atomic>
-#include <chrono>
-#include <mutex>
+#include <memory>
 
 enum class NodeType : uint8_t {
     EXACT,     // exact evaluation
@@ -28,75 +28,150 @@ struct TTEntry {
     int generation;   // move generation when stored
 };
 
+// Fixed-size, lock-free hash table.
+// Every slot holds two 64-bit words: the packed entry data and (key ^ data). A reader only accepts
+// a slot if both words agree with the probed key, so a torn write from another thread simply looks
+// like a miss and no locking is needed. Slots are grouped into 64-byte buckets, so a probe or a store
+// touches exactly one cache line.
 class TranspositionTable {
 public:
-    TranspositionTable() {
-        running = true;
-        cleanupThread = std::thread(&TranspositionTable::cleanupLoop, this);
+    explicit TranspositionTable(size_t mb = 64) {
+        resize(mb);
     }
 
-    ~TranspositionTable() {
-        running = false;
-        if (cleanupThread.joinable()) {
-            cleanupThread.join();
-        }
+    // Reallocates the table to the largest power-of-two bucket count that fits into mb megabytes.
+    // Must not be called while a search is running.
+    void resize(size_t mb) {
+        size_t bytes = std::max<size_t>(mb, 1) * 1024 * 1024;
+        size_t count = 1;
+        while (count * 2 * sizeof(Bucket) <= bytes) count *= 2;
+
+        buckets = std::make_unique<Bucket[]>(count);
+        bucketMask = count - 1;
+        clear();
     }
 
-    TTEntry* probe(uint64_t key) {
-        std::shared_lock<std::shared_mutex> lock(mtx);
-        auto it = table.find(key);
-        if (it != table.end()) {
-            if (currentGeneration - it->second.generation > maxAge) {
-                return nullptr;
+    bool probe(uint64_t key, TTEntry &out) const {
+        stats::count(stats::TT_PROBES);
+        const Bucket &b = buckets[key & bucketMask];
+        for (const Slot &s : b.slots) {
+            uint64_t data = s.data.load(std::memory_order_relaxed);
+            uint64_t check = s.check.load(std::memory_order_relaxed);
+            if ((check ^ data) == key && data != 0) {
+                out = unpack(data);
+                stats::count(stats::TT_HITS);
+                return true;
             }
-            return &it->second;
         }
-        return nullptr;
+        return false;
     }
 
+    // Replacement: an existing slot for the same key is overwritten unless it holds a deeper result
+    // from the current search; otherwise the slot with the lowest depth, penalised by its age, goes.
     void store(uint64_t key, int depth, int score, NodeType type, Move bestMove) {
-        std::unique_lock<std::shared_mutex> lock(mtx);
-        TTEntry entry{depth, score, type, bestMove, currentGeneration};
-        auto it = table.find(key);
-        if (it == table.end() || depth >= it->second.depth) {
-            table[key] = entry;
+        Bucket &b = buckets[key & bucketMask];
+        uint8_t gen = generation.load(std::memory_order_relaxed);
+
+        Slot *replace = nullptr;
+        int replaceValue = INT_MAX;
+        bool sameKey = false;
+        for (Slot &s : b.slots) {
+            uint64_t data = s.data.load(std::memory_order_relaxed);
+            uint64_t check = s.check.load(std::memory_order_relaxed);
+            if ((check ^ data) == key && data != 0) {
+                TTEntry old = unpack(data);
+                if (old.generation == gen && old.depth > depth && type != NodeType::EXACT) return;
+                // keep the old best move if the new result does not have one
+                if (bestMove == Move()) bestMove = old.bestMove;
+                replace = &s;
+                sameKey = true;
+                break;
+            }
+            TTEntry old = unpack(data);
+            int age = (gen - old.generation) & GEN_MASK;
+            int value = data == 0 ? INT_MIN : old.depth - 8 * age;
+            if (value < replaceValue) {
+                replaceValue = value;
+                replace = &s;
+            }
         }
+
+        stats::count(stats::TT_STORES);
+        if (!sameKey && replace->data.load(std::memory_order_relaxed) != 0) stats::count(stats::TT_OVERWRITES);
+
+        uint64_t data = pack(depth, score, type, bestMove, gen);
+        replace->data.store(data, std::memory_order_relaxed);
+        replace->check.store(key ^ data, std::memory_order_relaxed);
     }
 
     void clear() {
-        std::unique_lock<std::shared_mutex> lock(mtx);
-        table.clear();
+        for (size_t i = 0; i <= bucketMask; ++i) {
+            for (Slot &s : buckets[i].slots) {
+                s.data.store(0, std::memory_order_relaxed);
+                s.check.store(0, std::memory_order_relaxed);
+            }
+        }
+        generation = 0;
     }
 
     void newMove() {
-        currentGeneration++;
+        generation.store((generation.load(std::memory_order_relaxed) + 1) & GEN_MASK, std::memory_order_relaxed);
     }
 
-private:
-    void cleanupLoop() {
-        using namespace std::chrono_literals;
-        while (running) {
-            std::this_thread::sleep_for(100ms); // cleanup every 100ms
-
-            std::unique_lock<std::shared_mutex> lock(mtx);
-            for (auto it = table.begin(); it != table.end();) {
-                if (currentGeneration - it->second.generation > maxAge) {
-                    it = table.erase(it);
-                } else {
-                    ++it;
-                }
+    size_t sizeBytes() const { return (bucketMask + 1) * sizeof(Bucket); }
+
+    // Permille of the table filled by the current search, estimated from the first 1000 slots
+    int hashfull() const {
+        uint8_t gen = generation.load(std::memory_order_relaxed);
+        size_t sample = std::min<size_t>(1000 / SLOTS_PER_BUCKET, bucketMask + 1);
+        int used = 0;
+        for (size_t i = 0; i < sample; ++i) {
+            for (const Slot &s : buckets[i].slots) {
+                uint64_t data = s.data.load(std::memory_order_relaxed);
+                if (data != 0 && unpack(data).generation == gen) used++;
             }
         }
+        return int(used * 1000 / (sample * SLOTS_PER_BUCKET));
     }
 
-    std::unordered_map<uint64_t, TTEntry> table;
-    std::shared_mutex mtx;
-    int currentGeneration = 0;
+private:
+    static constexpr int SLOTS_PER_BUCKET = 4;
+    static constexpr int GEN_MASK = 0x3f;
+
+    struct Slot {
+        std::atomic<uint64_t> check{0};
+        std::atomic<uint64_t> data{0};
+    };
+
+    struct alignas(64) Bucket {
+        Slot slots[SLOTS_PER_BUCKET];
+    };
+    static_assert(sizeof(Bucket) == 64, "a bucket must fill exactly one cache line");
+
+    // data layout: score (32) | move (16) | depth (8) | generation (6) | type (2)
+    static uint64_t pack(int depth, int score, NodeType type, Move bestMove, uint8_t gen) {
+        uint64_t d = uint64_t(uint32_t(score)) << 32;
+        d |= uint64_t(uint16_t(bestMove.to_from())) << 16;
+        // depth is stored off by one so that a used slot never packs to zero
+        d |= uint64_t(std::clamp(depth, 0, 254) + 1) << 8;
+        d |= uint64_t(gen & GEN_MASK) << 2;
+        d |= uint64_t(type);
+        return d;
+    }
 
-    static constexpr int maxAge = 8;
+    static TTEntry unpack(uint64_t d) {
+        TTEntry e;
+        e.score = int32_t(uint32_t(d >> 32));
+        e.bestMove = Move(uint16_t(d >> 16));
+        e.depth = int((d >> 8) & 0xff) - 1;
+        e.generation = int((d >> 2) & 0x3f);
+        e.type = NodeType(d & 0x3);
+        return e;
+    }
 
-    std::atomic<bool> running;
-    std::thread cleanupThread;
+    std::unique_ptr<Bucket[]> buckets;
+    size_t bucketMask = 0;
+    std::atomic<uint8_t> generation{0};
 };
 
 #endif //CHESS_TRANSPOSITIONTABLE_H
@@ -0,0 +1,44 @@
+//
+// Created by fabian on 10/18/26.
+//
+
+#include "attacks.h"
+#include "sliders.h"
+
+template<Color C>
+static void compute_side(const Board &b, AttackInfo &ai) {
+    const Bitboard pawns = b.bitboard_of(C, PAWN);
+    const Bitboard pawnsWest = C == WHITE ? shift<NORTH_WEST>(pawns) : shift<SOUTH_WEST>(pawns);
+    const Bitboard pawnsEast = C == WHITE ? shift<NORTH_EAST>(pawns) : shift<SOUTH_EAST>(pawns);
+
+    Bitboard all = pawnsWest | pawnsEast;
+    Bitboard twice = pawnsWest & pawnsEast;
+    ai.attackedBy[C][PAWN] = all;
+
+    for (PieceType pt : {KNIGHT, BISHOP, ROOK, QUEEN, KING}) {
+        Bitboard byType = 0;
+        Bitboard pieces = b.bitboard_of(C, pt);
+        while (pieces) {
+            Square s = pop_lsb(&pieces);
+            Bitboard a = piece_attacks(pt, s, ai.occupied);
+            ai.pieceAttacks[s] = a;
+            twice |= all & a;
+            all |= a;
+            byType |= a;
+        }
+        ai.attackedBy[C][pt] = byType;
+    }
+
+    ai.attacked[C] = ai.attackedBy[C][PAWN] | ai.attackedBy[C][KNIGHT] | ai.attackedBy[C][BISHOP]
+                   | ai.attackedBy[C][ROOK] | ai.attackedBy[C][QUEEN];
+    ai.attackedTwice[C] = twice;
+
+    ai.kingSquare[C] = bsf(b.bitboard_of(C, KING));
+    ai.kingZone[C] = ai.attackedBy[C][KING] | SQUARE_BB[ai.kingSquare[C]];
+}
+
+void compute_attacks(const Board &b, AttackInfo &ai) {
+    ai.occupied = b.all_pieces<WHITE>() | b.all_pieces<BLACK>();
+    compute_side<WHITE>(b, ai);
+    compute_side<BLACK>(b, ai);
+}
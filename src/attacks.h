@@ -0,0 +1,27 @@
+//
+// Created by fabian on 10/18/26.
+//
+
+#ifndef CHESS_ATTACKS_H
+#define CHESS_ATTACKS_H
+
+#pragma once
+
+#include "../lib/surge/src/types.h"
+#include "Board.h"
+
+// What both sides attack, computed once per evaluation with one attack lookup per piece; every
+// evaluation term reads from here instead of generating attacks of its own.
+struct AttackInfo {
+    Bitboard occupied;
+    Bitboard attackedBy[NCOLORS][NPIECE_TYPES];   // squares attacked by the pieces of one type
+    Bitboard attacked[NCOLORS];                   // by any piece except the king, as in Position::attackers_from
+    Bitboard attackedTwice[NCOLORS];              // by at least two pieces, the king included
+    Bitboard kingZone[NCOLORS];                   // the king's square and the squares around it
+    Square kingSquare[NCOLORS];
+    Bitboard pieceAttacks[NSQUARES];              // attacks of the knight, bishop, rook, queen or king on a square
+};
+
+void compute_attacks(const Board &b, AttackInfo &ai);
+
+#endif //CHESS_ATTACKS_H
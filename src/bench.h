@@ -0,0 +1,19 @@
+//
+// Created by fabian on 10/18/26.
+//
+
+#ifndef CHESS_BENCH_H
+#define CHESS_BENCH_H
+
+#pragma once
+
+#include <cstdint>
+
+// Searches a fixed set of positions to a fixed depth, each one with empty tables, and prints the time,
+// the speed and the total number of nodes. With one thread the node count only changes when the search
+// or the evaluation does, so it serves as a signature of the engine's behaviour.
+// With splitPoints the threads share the tree through YBWC split points instead of Lazy SMP.
+// Returns the total number of nodes.
+uint64_t bench(int depth, int threads, int hashMb, bool splitPoints);
+
+#endif //CHESS_BENCH_H
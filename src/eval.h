@@ -9,10 +9,28 @@
 
 #include "../lib/surge/src/position.h"
 #include "../lib/surge/src/types.h"
+#include "Board.h"
+#include "EvalParams.h"
 
+// Piece values of the search (exchange evaluation, move ordering); the evaluation has its own in EvalParams
 int piece_value(int piece);
 
+// No evaluation reaches this, a window of (-EVAL_INFINITE, EVAL_INFINITE) asks for the exact score
+constexpr int EVAL_INFINITE = 1 << 30;
+
+// Score from the side to move's point of view. Inside (alpha, beta) the score is exact. Outside the window
+// the evaluation may stop early: it then returns a score on the same side of the window as the exact one.
+template<Color Us>
+int evaluate(Board &p, int alpha = -EVAL_INFINITE, int beta = EVAL_INFINITE);
+
+// The hand-written evaluation of this file is used unless a network has been loaded (see NNUE.h) and enabled
 template<Color Us>
-int evaluate(Position &p);
+int evaluate_classical(Board &p, int alpha = -EVAL_INFINITE, int beta = EVAL_INFINITE);
+
+// The classical evaluation from White's point of view, counting how often it uses each weight into trace
+int trace_evaluation(Board &p, EvalTrace &trace);
+
+void set_use_nnue(bool enabled);
+bool get_use_nnue();
 
 #endif //CHESS_EVAL_H
\ No newline at end of file
@@ -0,0 +1,109 @@
+//
+// Created by fabian on 10/18/26.
+//
+
+#include "pawns.h"
+
+#include <algorithm>
+#include <memory>
+
+static constexpr int PAWN_TABLE_SIZE = 16384;   // entries per thread, a power of two
+
+static Bitboard FORWARD_FILE[NCOLORS][NSQUARES];    // squares in front of a pawn on its file
+static Bitboard PASSED_SPAN[NCOLORS][NSQUARES];     // squares in front of a pawn on its own and the adjacent files
+static Bitboard ADJACENT_FILES[8];
+static Bitboard RANKS_BEHIND[NCOLORS][8];           // the given rank and every rank behind it
+
+static const bool pawn_masks_initialised = [] {
+    for (int f = 0; f < 8; ++f) {
+        ADJACENT_FILES[f] = (f > 0 ? MASK_FILE[f - 1] : 0) | (f < 7 ? MASK_FILE[f + 1] : 0);
+    }
+    for (int r = 0; r < 8; ++r) {
+        RANKS_BEHIND[WHITE][r] = RANKS_BEHIND[BLACK][r] = 0;
+        for (int r2 = 0; r2 <= r; ++r2) RANKS_BEHIND[WHITE][r] |= MASK_RANK[r2];
+        for (int r2 = r; r2 < 8; ++r2) RANKS_BEHIND[BLACK][r] |= MASK_RANK[r2];
+    }
+    for (int sq = 0; sq < 64; ++sq) {
+        Square s = Square(sq);
+        Bitboard file = MASK_FILE[file_of(s)];
+        Bitboard span = file | ADJACENT_FILES[file_of(s)];
+        FORWARD_FILE[WHITE][sq] = file & ~RANKS_BEHIND[WHITE][rank_of(s)];
+        FORWARD_FILE[BLACK][sq] = file & ~RANKS_BEHIND[BLACK][rank_of(s)];
+        PASSED_SPAN[WHITE][sq] = span & ~RANKS_BEHIND[WHITE][rank_of(s)];
+        PASSED_SPAN[BLACK][sq] = span & ~RANKS_BEHIND[BLACK][rank_of(s)];
+    }
+    return true;
+}();
+
+template<Color Us, typename Trace>
+static EvalPair evaluate_pawns(Bitboard ours, Bitboard theirs, Trace &trace) {
+    constexpr Color Them = ~Us;
+    constexpr Direction Up = relative_dir<Us>(NORTH);
+    const EvalParams &P = eval_params;
+
+    EvalPair score = 0;
+
+    // pawns with an own pawn beside or diagonally behind them
+    const Bitboard supported = ours & pawn_attacks<Us>(ours);
+    const Bitboard phalanx = ours & (shift<EAST>(ours) | shift<WEST>(ours));
+    // stop squares that an enemy pawn controls
+    const Bitboard enemyControl = pawn_attacks<Them>(theirs);
+
+    Bitboard b = ours;
+    while (b) {
+        const Square s = pop_lsb(&b);
+        const int f = file_of(s);
+        const int rr = relative_rank<Us>(rank_of(s));
+        const Bitboard bb = SQUARE_BB[s];
+
+        const bool doubled = ours & FORWARD_FILE[Us][s];
+        const bool isolated = !(ours & ADJACENT_FILES[f]);
+        const bool connected = (supported | phalanx) & bb;
+
+        if (doubled) score += weigh(trace, Us, P.doubled);
+        if (isolated) score += weigh(trace, Us, P.isolated);
+        if (connected) score += weigh(trace, Us, P.connected[rr]);
+
+        // backward: no own pawn on an adjacent file can come to its support, and it cannot advance safely
+        if (!isolated && !connected
+            && !(ours & ADJACENT_FILES[f] & RANKS_BEHIND[Us][rank_of(s)])
+            && (shift<Up>(bb) & enemyControl)) {
+            score += weigh(trace, Us, P.backward);
+        }
+
+        // the rear pawn of a doubled pair is not counted as passed
+        if (!doubled && !(theirs & PASSED_SPAN[Us][s])) score += weigh(trace, Us, P.passed[rr]);
+    }
+    return score;
+}
+
+template<typename Trace>
+static EvalPair pawn_structure(const Board &b, Trace &trace) {
+    const Bitboard white = b.bitboard_of(WHITE, PAWN);
+    const Bitboard black = b.bitboard_of(BLACK, PAWN);
+    return evaluate_pawns<WHITE>(white, black, trace) - evaluate_pawns<BLACK>(black, white, trace);
+}
+
+static thread_local std::unique_ptr<PawnEntry[]> table;
+
+const PawnEntry &probe_pawns(const Board &b) {
+    if (!table) table = std::make_unique<PawnEntry[]>(PAWN_TABLE_SIZE);
+
+    // entries computed with other evaluation weights must not match
+    const uint64_t key = b.pawn_key() ^ eval_params_key;
+    PawnEntry &e = table[key & (PAWN_TABLE_SIZE - 1)];
+    if (e.key != key) {
+        NoTrace noTrace;
+        e.key = key;
+        e.score = pawn_structure(b, noTrace);
+    }
+    return e;
+}
+
+void clear_pawns() {
+    if (table) std::fill_n(table.get(), PAWN_TABLE_SIZE, PawnEntry{});
+}
+
+EvalPair trace_pawns(const Board &b, EvalTrace &trace) {
+    return pawn_structure(b, trace);
+}
@@ -0,0 +1,32 @@
+//
+// Created by fabian on 10/18/26.
+//
+
+#ifndef CHESS_PAWNS_H
+#define CHESS_PAWNS_H
+
+#pragma once
+
+#include "../lib/surge/src/types.h"
+#include "Board.h"
+#include "EvalParams.h"
+#include <cstdint>
+
+// Pawn structure of one pawn configuration. It only depends on the pawns, so it is computed once and
+// then reused from a per-thread hash table keyed by Board::pawn_key().
+struct PawnEntry {
+    uint64_t key = 0;
+    EvalPair score = 0;     // pawn structure score from White's point of view
+};
+
+// Returns the pawn structure of b, computing it on a miss. The entry stays valid until the
+// calling thread probes a different pawn configuration that maps to the same slot.
+const PawnEntry &probe_pawns(const Board &b);
+
+// Empties the calling thread's table
+void clear_pawns();
+
+// The score of probe_pawns, computed without the table, counting the weights it uses into trace
+EvalPair trace_pawns(const Board &b, EvalTrace &trace);
+
+#endif //CHESS_PAWNS_H
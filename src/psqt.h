@@ -0,0 +1,46 @@
+//
+// Created by fabian on 10/18/26.
+//
+
+#ifndef CHESS_PSQT_H
+#define CHESS_PSQT_H
+
+#pragma once
+
+#include "../lib/surge/src/types.h"
+#include <cstdint>
+
+// A midgame and an endgame value packed into one integer, so that both are summed with a single add.
+// The endgame half lives in the upper 32 bits; the +0x80000000 in eg_value undoes the borrow that a
+// negative midgame half takes from it.
+using EvalPair = int64_t;
+
+constexpr EvalPair S(int mg, int eg) {
+    return EvalPair((uint64_t(uint32_t(eg)) << 32) + uint64_t(int64_t(mg)));
+}
+
+constexpr int mg_value(EvalPair s) {
+    return int32_t(uint32_t(uint64_t(s)));
+}
+
+constexpr int eg_value(EvalPair s) {
+    return int32_t(uint32_t((uint64_t(s) + 0x80000000ULL) >> 32));
+}
+
+// Game phase: knights and bishops count 1, rooks 2 and queens 4, indexed by type_of(piece) (NO_PIECE has
+// type 6). All pieces of the starting position make PHASE_MAX, a pure pawn ending 0; extra queens from
+// promotions can take the count above PHASE_MAX.
+constexpr int PHASE_MAX = 24;
+constexpr int PIECE_PHASE[8] = {0, 1, 1, 2, 4, 0, 0, 0};
+
+// Blends the midgame and endgame halves by the phase
+constexpr int taper(EvalPair s, int phase) {
+    const int ph = phase < PHASE_MAX ? phase : PHASE_MAX;
+    return (mg_value(s) * ph + eg_value(s) * (PHASE_MAX - ph)) / PHASE_MAX;
+}
+
+// Material plus piece-square bonus of a piece on a square, from White's point of view
+// (black pieces are negative). Kings carry no material. NO_PIECE maps to zero.
+extern EvalPair PSQT[NPIECES][NSQUARES];
+
+#endif //CHESS_PSQT_H
@@ -4,33 +4,269 @@
 
 #include "search.h"
 #include <algorithm>
-#include <future>
+#include <array>
+#include <climits>
+#include <cmath>
 #include <vector>
 #include <random>
 #include <ranges>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <sstream>
 
 #include "EndgameDB.h"
+#include "MovePicker.h"
+#include "NNUE.h"
 #include "OpeningDB.h"
+#include "SearchStats.h"
 #include "SearchThreadpool.h"
+#include "TimeManager.h"
 #include "TranspositionTable.h"
+#include "pawns.h"
+#include "uci.h"
 
 using namespace std;
 
 using Score = int64_t;
 static constexpr Score INF = 1000000000; // large bound but << INT64_MAX
 static constexpr int MATE_SCORE = 10000000;
+static constexpr int MAX_DEPTH = 64;
+// Mate scores count the plies from the root: being mated n plies from the root scores -MATE_SCORE + n
+static constexpr int MATE_BOUND = MATE_SCORE - 256;
+// Tablebase wins score below every mate, so that a found mate is still preferred
+static constexpr int TB_WIN_SCORE = MATE_BOUND - 256;
+// Mate and tablebase scores at least this far from zero count plies from the root
+static constexpr int DECISIVE_BOUND = TB_WIN_SCORE - 256;
+
+// The transposition table keeps decisive scores relative to the node instead of the root, so that they stay
+// right when the position comes up at another ply or in a later search
+static inline int score_to_tt(int score, int ply) {
+    return score >= DECISIVE_BOUND ? score + ply : score <= -DECISIVE_BOUND ? score - ply : score;
+}
+
+static inline int score_from_tt(int score, int ply) {
+    return score >= DECISIVE_BOUND ? score - ply : score <= -DECISIVE_BOUND ? score + ply : score;
+}
 
 extern OpeningDB opening_db;
 TranspositionTable TT;
 EndgameDB endgame_db;
 
+// Lazy SMP: every search thread runs its own iterative deepening on a private copy of the root
+// position. The threads only communicate through the transposition table and this stop flag.
+static atomic<bool> stopSearch{false};
+static int searchThreads = max(1u, thread::hardware_concurrency());
+
+void set_search_threads(int n) {
+    searchThreads = max(1, n);
+}
+
+int get_search_threads() {
+    return searchThreads;
+}
+
+// A search thread that lives from one search to the next, so that the tables it keeps per thread (move
+// history, evaluation cache, pawn hash, accumulators) are warm when the next search starts. It runs one
+// job at a time.
+class SearchThread {
+public:
+    SearchThread() : worker(&SearchThread::idle_loop, this) {}
+
+    ~SearchThread() {
+        {
+            lock_guard<mutex> guard(lock);
+            quit = true;
+        }
+        wakeUp.notify_all();
+        worker.join();
+    }
+
+    // Starts job once the previous one is done
+    void run(function<void()> job) {
+        unique_lock<mutex> guard(lock);
+        wakeUp.wait(guard, [this] { return !busy; });
+        pending = std::move(job);
+        busy = true;
+        wakeUp.notify_all();
+    }
+
+    // Waits until the last job is done
+    void wait() {
+        unique_lock<mutex> guard(lock);
+        wakeUp.wait(guard, [this] { return !busy; });
+    }
+
+private:
+    void idle_loop() {
+        unique_lock<mutex> guard(lock);
+        while (true) {
+            wakeUp.wait(guard, [this] { return busy || quit; });
+            if (!busy) return;
+            guard.unlock();
+            pending();
+            guard.lock();
+            busy = false;
+            wakeUp.notify_all();
+        }
+    }
+
+    mutex lock;
+    condition_variable wakeUp;
+    function<void()> pending;
+    bool busy = false;
+    bool quit = false;
+    thread worker;      // last, it starts running in the constructor
+};
+
+// Thread 0 runs the main search, the others the Lazy SMP helpers. The pool is never destroyed: the threads
+// wait for work until the process ends, and so never run their thread_local destructors after the
+// statics of other files are gone.
+static vector<unique_ptr<SearchThread>> &searchPool = *new vector<unique_ptr<SearchThread>>;
+
+// Matches the pool to the thread count set since the last search
+static void resize_pool() {
+    while (searchPool.size() > size_t(searchThreads)) searchPool.pop_back();
+    while (searchPool.size() < size_t(searchThreads)) searchPool.push_back(make_unique<SearchThread>());
+}
+
+// Runs job on every search thread and waits for all of them
+static void on_every_thread(const function<void()> &job) {
+    resize_pool();
+    for (auto &t : searchPool) t->run(job);
+    for (auto &t : searchPool) t->wait();
+}
+
+// Limits of the running search. Every thread counts its nodes locally and publishes them in batches;
+// the batch boundary is also where the hard deadline and the node limit are polled.
+static SearchLimits searchLimits;
+static TimeManager timeManager;
+static int rootPly = 0;
+static chrono::steady_clock::time_point searchStart;
+static atomic<uint64_t> nodesSearched{0};
+static thread_local uint64_t localNodes = 0;
+static constexpr uint64_t NODE_BATCH = 1024;
+
+static inline void count_node() {
+    if (++localNodes < NODE_BATCH) return;
+    uint64_t total = nodesSearched.fetch_add(localNodes, memory_order_relaxed) + localNodes;
+    localNodes = 0;
+    if ((searchLimits.nodes && total >= searchLimits.nodes) || timeManager.hard_expired()) {
+        stopSearch.store(true, memory_order_relaxed);
+    }
+}
+
+static inline void flush_nodes() {
+    nodesSearched.fetch_add(localNodes, memory_order_relaxed);
+    localNodes = 0;
+}
+
+void prepare_search(const SearchLimits &limits) {
+    stopSearch.store(false, memory_order_relaxed);
+    timeManager.start_clock(limits.ponder);
+}
+
+void stop_search() {
+    stopSearch.store(true, memory_order_relaxed);
+}
+
+uint64_t searched_nodes() {
+    return nodesSearched.load(memory_order_relaxed) + localNodes;
+}
+
+void ponderhit() {
+    timeManager.ponderhit();
+}
+
+// killers, history and countermoves are per thread, so they need no locking
+static thread_local MoveHistory moveHistory;
+
+// Full evaluations of recently seen positions, per thread like the move history. The stand pat of
+// quiescence, the static evaluation of a node and transpositions keep evaluating the same positions.
+struct EvalCacheEntry {
+    uint64_t key;
+    int score;
+};
+static constexpr size_t EVAL_CACHE_SIZE = 1 << 13;
+static thread_local unique_ptr<EvalCacheEntry[]> evalCache;
+
+// evaluate through the cache. Only exact scores are stored: a lazy evaluation that stopped outside the
+// window just bounds the score.
+template<Color Us>
+static int cached_evaluate(Board &p, int alpha = -EVAL_INFINITE, int beta = EVAL_INFINITE) {
+    if (!evalCache) evalCache = make_unique<EvalCacheEntry[]>(EVAL_CACHE_SIZE);
+    // other networks and other classical weights score the same position differently
+    const uint64_t key = p.get_hash() ^ (get_use_nnue() ? 0x9E3779B97F4A7C15ULL * nnue.network_id() : eval_params_key);
+    EvalCacheEntry &e = evalCache[key & (EVAL_CACHE_SIZE - 1)];
+    if (e.key == key) {
+        stats::count(stats::EVAL_CACHE_HITS);
+        return e.score;
+    }
+
+    int score = evaluate<Us>(p, alpha, beta);
+    if (alpha < score && score < beta) e = {key, score};
+    return score;
+}
+
+// Info lines of completed iterations; bench turns them off
+static bool searchOutput = true;
+
+void set_search_output(bool enabled) {
+    searchOutput = enabled;
+}
+
+static inline bool is_quiet(Move m) {
+    return !(m.flags() & CAPTURE) && m.flags() != PR_QUEEN;
+}
+
+// Static evaluation of the nodes on the current path by ply, to tell whether the side to move is improving
+static constexpr int NO_EVAL = INT_MIN;
+static thread_local int staticEvals[MoveHistory::MAX_PLY];
+
+// Late move reductions by remaining depth and move number. They grow with log(depth) * log(moveNumber):
+// a late move at a deep node is the least likely to matter.
+static const auto LMR_TABLE = [] {
+    array<array<int, 64>, MAX_DEPTH + 1> table{};
+    for (int d = 1; d <= MAX_DEPTH; ++d) {
+        for (int m = 1; m < 64; ++m) table[d][m] = int(0.75 + log(d) * log(m) / 2.25);
+    }
+    return table;
+}();
+
+// Reduction of a quiet move, to be called after the move has been played. Moves that are searched to
+// full depth anyway (early moves, tactical moves, moves out of check) return 0.
 template<Color Us>
-int quiescence(Position &p, int alpha, int beta) {
+static int late_move_reduction(const Board &p, Move m, int depth, int moveCount, bool pvNode, bool inCheck,
+                               bool improving) {
+    if (depth < 3 || moveCount <= (pvNode ? 3 : 2) || inCheck || !is_quiet(m)) return 0;
+
+    int r = LMR_TABLE[min(depth, MAX_DEPTH)][min(moveCount, 63)];
+    if (pvNode) r--;
+    if (!improving) r++;
+    if (p.in_check<~Us>()) r--;     // the move gives check
+
+    // the position is the one after m, its ply is the one the killers of m were stored for
+    int ply = MoveHistory::ply_index(p.ply() - 1);
+    if (m == moveHistory.killers[ply][0] || m == moveHistory.killers[ply][1]) r--;
+    r -= moveHistory.butterfly[Us][m.from()][m.to()] / (MoveHistory::HISTORY_MAX / 2);
+
+    // always leave at least one ply
+    return clamp(r, 0, depth - 2);
+}
+
+template<Color Us>
+int quiescence(Board &p, int alpha, int beta) {
+    count_node();
+    stats::NodeScope statsScope(0);
+    stats::count(stats::QNODES);
     if (p.in_check<Us>() || p.in_check<~Us>()) {
-        MoveList<Us> moves(p);
-        if (moves.size() == 0) return -MATE_SCORE; // checkmate
+        MovePicker<Us> picker(p, moveHistory, Move());
+        if (picker.size() == 0) return -MATE_SCORE + (p.ply() - rootPly); // checkmate
 
-        for (auto &m : moves) {
+        for (Move m = picker.next(); m != Move(); m = picker.next()) {
             p.play<Us>(m);
             int score = -quiescence<~Us>(p, -beta, -alpha);
             p.undo<Us>(m);
@@ -40,27 +276,14 @@ int quiescence(Position &p, int alpha, int beta) {
         return alpha;
     }
 
-    int stand = evaluate<Us>(p);
+    // the evaluation may stop early once it is clear that the stand pat fails high or low
+    int stand = cached_evaluate<Us>(p, alpha, beta);
     if (stand >= beta) return beta;
     if (alpha < stand) alpha = stand;
-    MoveList<Us> moves(p);
-    // only consider captures and promotions
-    vector<Move> essential_moves;
-
-    for (auto &m: moves) {
-        MoveFlags f = m.flags();
-        bool isPromotion = (f >= MoveFlags::PR_KNIGHT && f <= MoveFlags::PR_QUEEN) ||
-                           (f >= MoveFlags::PC_KNIGHT && f <= MoveFlags::PC_QUEEN);
-        if (m.is_capture() || isPromotion) essential_moves.push_back(m);
-    }
 
-    // sort
-    sort(essential_moves.begin(), essential_moves.end(), [&](const Move &a, const Move &b) {
-        int va = a.is_capture() ? piece_value(p.at(a.to())) : 0;
-        int vb = b.is_capture() ? piece_value(p.at(b.to())) : 0;
-        return va > vb;
-    });
-    for (auto &m: essential_moves) {
+    // only captures and promotions that do not lose material (SEE >= 0), MVV-LVA ordered
+    MovePicker<Us> picker(p, moveHistory);
+    for (Move m = picker.next(); m != Move(); m = picker.next()) {
         p.play<Us>(m);
         int score = -quiescence<~Us>(p, -beta, -alpha);
         p.undo<Us>(m);
@@ -70,269 +293,565 @@ int quiescence(Position &p, int alpha, int beta) {
     return alpha;
 }
 
+// Split-point (YBWC) parallelism: once the first move of a node has been searched, the remaining
+// siblings are handed to the work-stealing pool. Used instead of Lazy SMP when enabled.
+static bool useSplitPoints = false;
+static constexpr int SPLIT_MIN_DEPTH = 4;
+static unique_ptr<SearchThreadPool> pool;
 
-SearchThreadPool pool(std::thread::hardware_concurrency());
+void set_split_points(bool enabled) {
+    useSplitPoints = enabled;
+}
+
+bool get_split_points() {
+    return useSplitPoints;
+}
+
+void clear_search() {
+    TT.clear();
+    on_every_thread([] {
+        moveHistory.clear();
+        if (evalCache) fill_n(evalCache.get(), EVAL_CACHE_SIZE, EvalCacheEntry{});
+        clear_pawns();
+    });
+    // the workers of the split points are not reachable one by one; new ones start with empty tables
+    pool.reset();
+}
+
+// True once the whole search is stopped or the subtree we are in was cancelled by a sibling's cutoff
+static inline bool search_aborted() {
+    return stopSearch.load(memory_order_relaxed) || SearchThreadPool::cancelled();
+}
+
+template<Color Us>
+struct SplitPoint {
+    Board::Snapshot pos;    // parent position, every task starts a board of its own from it
+    int depth;
+    int beta;
+    bool tryCache;
+    bool pvNode, inCheck, improving;    // of the parent, for the reductions of the siblings
+    int staticEvals[2];     // of the parent's parent and the parent, which the child and grandchild compare with
+    atomic<int> alpha;      // shared, so late siblings use the best bound found so far
+    mutex lock;
+    int bestScore;
+    Move bestMove;
+    TaskGroup group;
+};
+
+template<Color Us>
+struct SplitTask : SearchTask {
+    SplitPoint<Us> *sp;
+    Move m;
+    int moveNumber;
+};
+
+template<Color Us>
+static void run_split_task(SearchTask &task) {
+    auto &t = static_cast<SplitTask<Us> &>(task);
+    SplitPoint<Us> &sp = *t.sp;
+
+    // The path arrays of this thread hold its own search, not the split point's: it may have stolen the task,
+    // or be helping while a search of its own waits on the same plies. The entries below the task are
+    // taken from the split point for the task and put back afterwards.
+    Board child(sp.pos);
+    const int parent = MoveHistory::ply_index(child.ply()), grandparent = MoveHistory::ply_index(child.ply() - 1);
+    child.play<Us>(t.m);
+    const int ply = MoveHistory::ply_index(child.ply());
+    const int savedEvals[2] = {staticEvals[grandparent], staticEvals[parent]};
+    const Move savedMove = moveHistory.played[ply];
+    staticEvals[grandparent] = sp.staticEvals[0];
+    staticEvals[parent] = sp.staticEvals[1];
+    moveHistory.played[ply] = t.m;
+
+    int alpha = sp.alpha.load(memory_order_relaxed);
+    int r = late_move_reduction<Us>(child, t.m, sp.depth, t.moveNumber, sp.pvNode, sp.inCheck, sp.improving);
+    int score = -parallel_alphabeta_pvs<~Us>(child, sp.depth - 1 - r, -alpha-1, -alpha, true, sp.tryCache);
+    if (r > 0 && score > alpha && !search_aborted()) {
+        score = -parallel_alphabeta_pvs<~Us>(child, sp.depth - 1, -alpha-1, -alpha, true, sp.tryCache);
+    }
+    if( score > alpha && score < sp.beta && !search_aborted() ) {
+        // research with window [alfa;beta]
+        alpha = sp.alpha.load(memory_order_relaxed);
+        score = -parallel_alphabeta_pvs<~Us>(child, sp.depth-1, -sp.beta, -alpha, true, sp.tryCache);
+    }
+    staticEvals[grandparent] = savedEvals[0];
+    staticEvals[parent] = savedEvals[1];
+    moveHistory.played[ply] = savedMove;
+    if (search_aborted()) return;
+
+    lock_guard<mutex> guard(sp.lock);
+    if (score > sp.bestScore) {
+        sp.bestScore = score;
+        sp.bestMove = t.m;
+    }
+    if (score > sp.alpha.load(memory_order_relaxed)) sp.alpha.store(score, memory_order_relaxed);
+    // beta cutoff: the remaining siblings are useless, cancel them and everything below them
+    if (score >= sp.beta) sp.group.cancel.store(true, memory_order_relaxed);
+}
+
+// Searches the moves [first, last) of a node in parallel and waits for them, helping the pool meanwhile.
+// bestScore/bestMove hold the result of the moves searched before the split and receive the final result.
+// firstMoveNumber is the move number of *first, counted from 1, which decides its reduction.
+template<Color Us>
+static void split_search(Board &p, const Move *first, const Move *last, int firstMoveNumber, int depth, int alpha,
+                         int beta, bool pvNode, bool inCheck, bool improving, bool tryCache, int &bestScore,
+                         Move &bestMove) {
+    SplitPoint<Us> sp;
+    sp.pos = p.snapshot();
+    sp.depth = depth;
+    sp.beta = beta;
+    sp.tryCache = tryCache;
+    sp.pvNode = pvNode;
+    sp.inCheck = inCheck;
+    sp.improving = improving;
+    sp.staticEvals[0] = staticEvals[MoveHistory::ply_index(p.ply() - 1)];
+    sp.staticEvals[1] = staticEvals[MoveHistory::ply_index(p.ply())];
+    sp.alpha = alpha;
+    sp.bestScore = bestScore;
+    sp.bestMove = bestMove;
+    sp.group.parent = SearchThreadPool::current_group();
+
+    SplitTask<Us> tasks[218];
+    int taskCount = int(last - first);
+    // pushed in reverse, so the owner pops the better ordered moves first
+    for (int i = taskCount - 1; i >= 0; --i) {
+        tasks[i].run = run_split_task<Us>;
+        tasks[i].sp = &sp;
+        tasks[i].m = first[i];
+        tasks[i].moveNumber = firstMoveNumber + i;
+        if (!pool->submit(tasks[i], sp.group)) run_split_task<Us>(tasks[i]);
+    }
+    pool->wait(sp.group);
+
+    bestScore = sp.bestScore;
+    bestMove = sp.bestMove;
+}
 
 // Alpha-beta search
 template<Color Us>
-int parallel_alphabeta_pvs(Position &p, int depth, int alpha, int beta, bool tryParallel, bool tryCache) {
+int parallel_alphabeta_pvs(Board &p, int depth, int alpha, int beta, bool tryParallel, bool tryCache) {
+    count_node();
+    stats::NodeScope statsScope(depth);
+    stats::count(stats::NODES);
+    if (search_aborted()) return 0;
+
+    // Draws by the fifty move rule or repetition. If the side to move can repeat a position of the search
+    // with one reversible move, it can hold at least a draw, so the line is cut as soon as it turns into a cycle.
+    const int ply = p.ply() - rootPly;
+    if (ply > 0) {
+        if (p.rule50() >= 100 || p.is_repetition(ply)) return 0;
+        if (alpha < 0 && p.has_game_cycle(ply)) {
+            alpha = 0;
+            if (alpha >= beta) return alpha;
+        }
+    }
+
     // TT Lookup
     uint64_t key = p.get_hash();
+    Move ttMove;
     if (tryCache) {
-        TTEntry* entry = TT.probe(key);
-        if (entry && entry->depth >= depth) {
-            switch (entry->type) {
-                case NodeType::EXACT: return entry->score;
-                case NodeType::LOWER: if (entry->score > alpha) alpha = entry->score; break;
-                case NodeType::UPPER: if (entry->score < beta)  beta  = entry->score; break;
+        TTEntry entry;
+        bool hit = TT.probe(key, entry);
+        if (hit) ttMove = entry.bestMove;
+        if (hit && entry.depth >= depth) {
+            const int ttScore = score_from_tt(entry.score, ply);
+            switch (entry.type) {
+                case NodeType::EXACT: return ttScore;
+                case NodeType::LOWER: if (ttScore > alpha) alpha = ttScore; break;
+                case NodeType::UPPER: if (ttScore < beta)  beta  = ttScore; break;
             }
-            if (alpha >= beta) return entry->score;
+            if (alpha >= beta) return ttScore;
         }
     }
-    int wdl;
-    if (depth > 1 && endgame_db.probe_wdl(p, wdl)) {
-        
+    // Tablebase cutoff. The tables only know positions right after a capture or pawn move; positions with as
+    // many pieces as the largest tables are the expensive ones and are left alone close to the leaves.
+    if (p.rule50() == 0 && endgame_db.available()) {
+        int pieces = pop_count(p.all_pieces<WHITE>() | p.all_pieces<BLACK>());
+        int wdl;
+        if ((pieces < endgame_db.max_pieces() || (pieces == endgame_db.max_pieces() && depth >= endgame_db.probe_depth()))
+            && endgame_db.probe_wdl(p, wdl)) {
+            // a won or lost position is only a bound, the search may still find a mate
+            int score = wdl == 2 ? TB_WIN_SCORE - ply
+                      : wdl == -2 ? -TB_WIN_SCORE + ply : wdl;
+            NodeType type = wdl == 2 ? NodeType::LOWER : wdl == -2 ? NodeType::UPPER : NodeType::EXACT;
+            if (type == NodeType::EXACT || (type == NodeType::LOWER ? score >= beta : score <= alpha)) {
+                TT.store(key, min(depth + 6, MAX_DEPTH), score_to_tt(score, ply), type, Move());
+                return score;
+            }
+        }
     }
 
     if (depth == 0) return quiescence<Us>(p, alpha, beta);
-    MoveList<Us> moves(p);
-    if (moves.size() == 0) {
+    MovePicker<Us> picker(p, moveHistory, ttMove);
+    if (picker.size() == 0) {
         // checkmate or stalemate
         // if king is attacked -> checkmate
-        if (p.in_check<Us>()) return -MATE_SCORE + (10 - depth);
+        if (p.in_check<Us>()) return -MATE_SCORE + ply;
         return 0; // stalemate
     }
 
-    // Null move pruning
-    if (depth >= 3 && !p.in_check<Us>()) {
-        Position copy = p;
-        copy.side_to_play = ~copy.side_to_play;
-        copy.hash ^= zobrist::side_key;
+    const bool inCheck = p.in_check<Us>();
+    const bool pvNode = beta - alpha > 1;
+    const int staticEval = inCheck ? NO_EVAL : cached_evaluate<Us>(p);
+    // better than two plies ago; when that is unknown, assume so, which reduces less
+    const int pastEval = ply >= 2 ? staticEvals[MoveHistory::ply_index(p.ply() - 2)] : NO_EVAL;
+    const bool improving = !inCheck && (pastEval == NO_EVAL || staticEval > pastEval);
+    staticEvals[MoveHistory::ply_index(p.ply())] = staticEval;
 
-        int score = -parallel_alphabeta_pvs<~Us>(copy, depth - 3, -beta, -beta + 1, tryParallel, false);
-        if (score >= beta) return beta;
+    // Null move pruning
+    if (depth >= 3 && !inCheck) {
+        p.play_null<Us>();
+        moveHistory.played[MoveHistory::ply_index(p.ply())] = Move();
+        stats::count(stats::NULL_MOVE_TRIES);
+        int score = -parallel_alphabeta_pvs<~Us>(p, depth - 3, -beta, -beta + 1, tryParallel, false);
+        p.undo_null<Us>();
+        if (score >= beta) {
+            stats::count(stats::NULL_MOVE_CUTOFFS);
+            return beta;
+        }
     }
 
-    // move ordering: simple: captures first
-    vector<Move> moveVec(moves.begin(), moves.end());
-    sort(moveVec.begin(), moveVec.end(), [&](const Move &a, const Move &b) {
-        int va = a.is_capture() ? piece_value(p.at(a.to())) : 0;
-        int vb = b.is_capture() ? piece_value(p.at(b.to())) : 0;
-        return va > vb;
-    });
-    int bestScore = -1000000;
+    // below every score a searched move can get, mated ones included
+    int bestScore = -MATE_SCORE;
     int score;
     Move bestMove;
     int origAlpha = alpha;
     int moveCount = 0;
-    std::vector<future<SearchResult>> futures;
     bool pvDone = false;
-    for (auto &m : moveVec) {
+    bool split = tryParallel && pool && depth >= SPLIT_MIN_DEPTH;
+    Move quietsTried[64];
+    int quietCount = 0;
+
+    for (Move m = picker.next(); m != Move(); m = picker.next()) {
         moveCount++;
 
         // Futility Pruning
-        if (depth == 1 && !p.in_check<Us>() && !m.is_capture()) {
-            int stand = evaluate<Us>(p);
-            if (stand + 800 <= alpha) continue;
+        if (depth == 1 && !inCheck && !m.is_capture()) {
+            if (staticEval + 800 <= alpha) {
+                stats::count(stats::FUTILITY_PRUNES);
+                continue;
+            }
         }
 
         // Late Move Pruning
-        if (depth <= 3 && moveCount > 12 && !p.in_check<Us>() && !m.is_capture()) {
+        if (depth <= 3 && moveCount > 12 && !inCheck && !m.is_capture()) {
+            stats::count(stats::LMP_PRUNES);
             continue;
         }
 
+        if (split && pvDone) {
+            // young brothers wait: the first move is done, the remaining siblings run in parallel.
+            // No pruning applies at split depths, so the rest of the list can go as is; the tasks reduce.
+            Move rest[218];
+            int restCount = 0;
+            for (; m != Move(); m = picker.next()) rest[restCount++] = m;
+            split_search<Us>(p, rest, rest + restCount, moveCount, depth, alpha, beta, pvNode, inCheck, improving,
+                             tryCache, bestScore, bestMove);
+            if (bestScore >= beta) stats::count(stats::BETA_CUTOFFS);
+            break;
+        }
+
+        p.play<Us>(m);
+        moveHistory.played[MoveHistory::ply_index(p.ply())] = m;
         if (!pvDone) { // pv
-            p.play<Us>(m);
-            int bestScore = -parallel_alphabeta_pvs<~Us>(p, depth - 1, -beta, -alpha, false, tryCache);
-            p.undo<Us>(m);
-            if( bestScore > alpha ) {
-                if( bestScore >= beta )
-                    return bestScore;
-                alpha = bestScore;
-            }
+            score = -parallel_alphabeta_pvs<~Us>(p, depth - 1, -beta, -alpha, tryParallel, tryCache);
             pvDone = true;
-        } else if (tryParallel) {
-            //cout << "Spawning parallel task for move " << m << " at depth " << depth << "\n";
-            std::promise<SearchResult> prom;
-            futures.push_back(prom.get_future());
-
-            pool.enqueue(packaged_task<void()>([p, depth, alpha, beta, m, prom = std::move(prom), tryCache]() mutable {
-                Position child = p;
-                child.play<Us>(m);
-                int score = -parallel_alphabeta_pvs<~Us>(child, depth - 1, -alpha-1, -alpha, false, tryCache);
-                if( score > alpha && score < beta ) {
-                    // research with window [alfa;beta]
-                    score = -parallel_alphabeta_pvs<~Us>(child, depth-1, -beta, -alpha, false, tryCache);
-                    if(score > alpha)
-                        alpha = score;
-                }
-                prom.set_value(SearchResult{score, m});
-            }));
         } else {
-            p.play<Us>(m);
-            score = -parallel_alphabeta_pvs<~Us>(p, depth - 1, -alpha-1, -alpha, false, tryCache);
+            // late quiet moves are searched shallower first and only searched again if they beat alpha
+            int r = late_move_reduction<Us>(p, m, depth, moveCount, pvNode, inCheck, improving);
+            score = -parallel_alphabeta_pvs<~Us>(p, depth - 1 - r, -alpha-1, -alpha, tryParallel, tryCache);
+            if (r > 0 && score > alpha) {
+                score = -parallel_alphabeta_pvs<~Us>(p, depth - 1, -alpha-1, -alpha, tryParallel, tryCache);
+            }
             if( score > alpha && score < beta ) {
                 // research with window [alfa;beta]
-                score = -parallel_alphabeta_pvs<~Us>(p, depth-1, -beta, -alpha, false, tryCache);
-                if(score > alpha)
-                    alpha = score;
+                score = -parallel_alphabeta_pvs<~Us>(p, depth-1, -beta, -alpha, tryParallel, tryCache);
             }
-            p.undo<Us>(m);
-            if (score > bestScore) {
-                bestScore = score;
-                bestMove = m;
-            }
-            if (bestScore > alpha) alpha = bestScore;
-            if (alpha >= beta) break;
         }
-    }
+        p.undo<Us>(m);
 
-    if (tryParallel) {
-        for (auto &fut : futures) {
-            auto res = fut.get();
-            int score = res.score;
-            if (score > bestScore) {
-                bestScore = score;
-                bestMove = res.move;
+        if (score > bestScore) {
+            bestScore = score;
+            bestMove = m;
+        }
+        if (bestScore > alpha) alpha = bestScore;
+        if (alpha >= beta) {
+            stats::count(stats::BETA_CUTOFFS);
+            if (moveCount == 1) stats::count(stats::FIRST_MOVE_CUTOFFS);
+            if (is_quiet(m) && !search_aborted()) {
+                moveHistory.update_quiet(Us, p, m, quietsTried, quietCount, depth);
             }
-            if (score > alpha) alpha = score;
-            if (alpha >= beta) break;
+            break;
         }
+        if (is_quiet(m) && quietCount < 64) quietsTried[quietCount++] = m;
     }
+
+    // results of an aborted search are incomplete and must not reach the table
+    if (search_aborted()) return 0;
+    // every move was pruned, none of them is expected to reach alpha
+    if (bestMove == Move()) bestScore = alpha;
+
     if (tryCache) {
         NodeType type;
         if (bestScore <= origAlpha) type = NodeType::UPPER;       // fail-low
         else if (bestScore >= beta) type = NodeType::LOWER;       // fail-high
         else type = NodeType::EXACT;                             // exact score
 
-        TT.store(key, depth, bestScore, type, bestMove);
+        TT.store(key, depth, score_to_tt(bestScore, ply), type, bestMove);
     }
     return bestScore;
 }
 
+struct RootResult {
+    Move bestMove;
+    Score score = 0;
+    int depth = 0;   // last fully completed depth
+};
+
+// Helper threads skip some depths so that they do not all search the same iteration in lockstep
+static constexpr int SKIP_SIZE[20]  = {1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4};
+static constexpr int SKIP_PHASE[20] = {0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7};
+
+// One iteration of the root search with an aspiration window around the previous score.
+// Returns false if the search was interrupted before the iteration completed.
 template<Color Us>
-Move find_best_move(Position &p, int maxDepth, int timeLimitMs) {
-    //TT.clear();
+static bool search_root(Board &p, int depth, RootResult &res) {
+    Score window = 500; // aspiration window
+    bool haveScore = res.depth > 0;
+    Score alpha = haveScore ? res.score - window : -INF;
+    Score beta  = haveScore ? res.score + window :  INF;
+
+    while (true) {
+        Score low = alpha;
+        Score high = beta;
+
+        Score currentBestScore = -INF;
+        Move currentBestMove;
+
+        // Get move list fresh each iteration
+        MoveList<Us> moves(p);
+        std::vector<Move> moveVec(moves.begin(), moves.end());
+
+        // Put previous best first for better move ordering
+        if (haveScore) {
+            auto it = std::find(moveVec.begin(), moveVec.end(), res.bestMove);
+            if (it != moveVec.end()) std::iter_swap(moveVec.begin(), it);
+        }
 
-    auto start = chrono::steady_clock::now();
+        // Root search loop
+        for (auto &m : moveVec) {
+            if (stopSearch.load(memory_order_relaxed)) return false;
+
+            p.play<Us>(m);
+            moveHistory.played[MoveHistory::ply_index(p.ply())] = m;
+            bool tryParallel = useSplitPoints;
+            bool tryCache = true;
+            Score score = -parallel_alphabeta_pvs<~Us>(p, depth - 1, -beta, -alpha, tryParallel, tryCache);
+            p.undo<Us>(m);
+            if (stopSearch.load(memory_order_relaxed)) return false;
+
+            if (score > currentBestScore) {
+                currentBestScore = score;
+                currentBestMove = m;
+            }
+            if (score > alpha) alpha = score;
+            if (alpha >= beta) break; // cutoff
+        }
+
+        // Aspiration window checks
+        if (currentBestScore <= low || currentBestScore >= high) {
+            // fail low / fail high → widen the window and retry
+            if (window >= INF / 2) {
+                alpha = -INF; beta = INF;
+            } else {
+                window = std::min(window * 2, INF / 2);
+                alpha = res.score - window;
+                beta  = res.score + window;
+            }
+            continue;
+        }
+
+        // success
+        res.score = currentBestScore;
+        res.bestMove = currentBestMove;
+        res.depth = depth;
+        return true;
+    }
+}
+
+// Body of a Lazy SMP helper: plain iterative deepening on its own position until the main thread stops it
+template<Color Us>
+static void helper_search(int id, const Board::Snapshot &root, int maxDepth, RootResult &res) {
+    Board p(root);
+    int skip = (id - 1) % 20;
+
+    for (int depth = 1; depth <= maxDepth && !stopSearch.load(memory_order_relaxed); ++depth) {
+        if (((depth + SKIP_PHASE[skip]) / SKIP_SIZE[skip]) % 2) continue;
+        if (!search_root<Us>(p, depth, res)) break;
+    }
+    flush_nodes();
+}
+
+// Follows the best moves stored in the transposition table, as long as they are legal
+template<Color Us>
+static void collect_pv(Board &p, int length, vector<Move> &pv) {
+    TTEntry entry;
+    if (length <= 0 || !TT.probe(p.get_hash(), entry) || entry.bestMove == Move()) return;
+
+    MoveList<Us> moves(p);
+    for (Move m : moves) {
+        if (m != entry.bestMove) continue;
+        pv.push_back(m);
+        p.play<Us>(m);
+        collect_pv<~Us>(p, length - 1, pv);
+        p.undo<Us>(m);
+        return;
+    }
+}
+
+template<Color Us>
+vector<Move> principal_variation(Board &p, Move best, int maxLength) {
+    vector<Move> pv;
+    if (best == Move() || maxLength <= 0) return pv;
+    pv.push_back(best);
+    p.play<Us>(best);
+    collect_pv<~Us>(p, maxLength - 1, pv);
+    p.undo<Us>(best);
+    return pv;
+}
+
+static string uci_score(Score score) {
+    if (score >= MATE_BOUND) return "mate " + to_string((MATE_SCORE - score + 1) / 2);
+    if (score <= -MATE_BOUND) return "mate -" + to_string((MATE_SCORE + score) / 2);
+    // internal scores are in thousandths of a pawn
+    return "cp " + to_string(score / 10);
+}
+
+// One UCI info line for a completed iteration of the main thread
+template<Color Us>
+static void report_iteration(Board &p, const RootResult &res) {
+    if (!searchOutput) return;
+    int64_t ms = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - searchStart).count();
+    uint64_t nodes = searched_nodes();
+
+    ostringstream info;
+    info << "info depth " << res.depth << " score " << uci_score(res.score) << " nodes " << nodes
+         << " nps " << nodes * 1000 / max<int64_t>(ms, 1) << " time " << ms << " hashfull " << TT.hashfull() << " tbhits " << endgame_db.hits() << " pv";
+    for (Move m : principal_variation<Us>(p, res.bestMove, res.depth)) info << " " << move_to_uci(m);
+    if (stats::ENABLED) {
+        info << "\ninfo string stats ";
+        stats::print_summary(info, stats::collect());
+    }
+    cout << info.str() << endl;
+}
+
+// A score drop of this much between two iterations counts as a fail low and earns extra time
+static constexpr Score FAIL_LOW_MARGIN = 300;
+
+// The search of thread 0, which starts the helpers and decides on the move
+template<Color Us>
+static Move main_search(Board &p, const SearchLimits &limits) {
+    //TT.clear();
+    TT.newMove();
+
+    // the stop flag and the clock were set by prepare_search; a stop or ponderhit that arrived since must still count
+    nodesSearched = 0;
+    localNodes = 0;
+    endgame_db.reset_hits();
+    stats::reset();
+    searchLimits = limits;
+    searchStart = chrono::steady_clock::now();
+    timeManager.init(limits, Us, p.game_ply());
+    rootPly = p.ply();
+    int maxDepth = limits.depth > 0 ? min(limits.depth, MAX_DEPTH) : MAX_DEPTH;
 
     // Opening book query
     Move book_move;
     MoveList<Us> rootMoves(p);
     if (maxDepth >= 3 && opening_db.probe(p, book_move)) {
-        for (auto &m : rootMoves) {
-            if (m.to() == book_move.to() && m.from() == book_move.from()) {
-                cout << "Opening Book move found: " << book_move << "\n";
-                return m;
-            }
-        }
+        cout << "info string book move " << move_to_uci(book_move) << endl;
+        return book_move;
     }
 
+    // checkmate or stalemate: there is nothing to search
+    if (rootMoves.size() == 0) return Move();
+
     // Endgame tablebase probe
     int dtz;
     Move result;
     if (endgame_db.probe_next_move(p, result, dtz)) {
-        cout << "Tablebase move found with DTZ=" << dtz << ": " << result << "\n";
-        return result;
+        // the tablebase only knows from, to and the promotion piece, the flags come from our own move list
+        auto promotion = [](Move m) { return m.flags() & PR_KNIGHT ? m.flags() & PR_QUEEN : 0; };
+        for (auto &m : rootMoves) {
+            if (m.from() == result.from() && m.to() == result.to() && promotion(m) == promotion(result)) {
+                cout << "info string tablebase move " << move_to_uci(m) << " dtz " << dtz << endl;
+                return m;
+            }
+        }
     }
 
-    Move bestMove;
-    Score prevScore = 0;
-    bool haveScore = false;
-
-    // Iterative deepening loop
-    for (int depth = 1; depth <= maxDepth; ++depth) {
-        auto now = chrono::steady_clock::now();
-        if (chrono::duration_cast<chrono::milliseconds>(now - start).count() >= timeLimitMs) {
-            break; // stop deepening
+    moveHistory.clear_killers();
+
+    const int threads = int(searchPool.size());
+    std::vector<RootResult> results(threads);
+    const Board::Snapshot root = p.snapshot();
+    if (useSplitPoints) {
+        // the main search takes part in the split points, so the work-stealing pool gets one thread less
+        // and the helpers of the search pool stay idle
+        if (!pool || pool->size() != size_t(threads - 1)) {
+            pool.reset();
+            if (threads > 1) pool = make_unique<SearchThreadPool>(threads - 1);
         }
+    } else {
+        // Start the helpers on private copies of the root position, which each builds on its own thread
+        for (int id = 1; id < threads; ++id) {
+            searchPool[id]->run([&, id] { helper_search<Us>(id, root, maxDepth, results[id]); });
+        }
+    }
 
-        cout << "Searching at depth " << depth << "..." << endl;
-
-        Score window = 500; // aspiration window
-        Score alpha = haveScore ? prevScore - window : -INF;
-        Score beta  = haveScore ? prevScore + window :  INF;
-
-        while (true) {
-            Score low = alpha;
-            Score high = beta;
-
-            Score currentBestScore = -INF;
-            Move currentBestMove;
+    // Iterative deepening loop; the hard deadline and the node limit stop it from inside the search
+    RootResult &main = results[0];
+    for (int depth = 1; depth <= maxDepth; ++depth) {
+        if (depth > 1 && timeManager.soft_expired()) break; // stop deepening
 
-            // Get move list fresh each iteration
-            MoveList<Us> moves(p);
-            std::vector<Move> moveVec(moves.begin(), moves.end());
+        Move previousMove = main.bestMove;
+        Score previousScore = main.score;
+        if (!search_root<Us>(p, depth, main)) break;
+        report_iteration<Us>(p, main);
 
-            // Put previous best first for better move ordering
-            if (haveScore) {
-                auto it = std::find(moveVec.begin(), moveVec.end(), bestMove);
-                if (it != moveVec.end()) std::iter_swap(moveVec.begin(), it);
-            }
+        if (depth > 1) {
+            timeManager.update(main.bestMove != previousMove, main.score < previousScore - FAIL_LOW_MARGIN);
+        }
+    }
 
-            // Root search loop
-            for (auto &m : moveVec) {
-                now = chrono::steady_clock::now();
-                if (duration_cast<chrono::milliseconds>(now - start).count() >= timeLimitMs) {
-                    goto TIMEOUT;
-                }
-
-                p.play<Us>(m);
-                bool tryParallel = false;//depth > 5;
-                bool tryCache = true;
-                Score score = -parallel_alphabeta_pvs<~Us>(p, depth - 1, -beta, -alpha, tryParallel, tryCache);
-                p.undo<Us>(m);
-                if (score > currentBestScore) {
-                    currentBestScore = score;
-                    currentBestMove = m;
-                }
-                if (score > alpha) alpha = score;
-                if (alpha >= beta) break; // cutoff
-            }
+    stopSearch = true;
+    for (int id = 1; id < threads; ++id) searchPool[id]->wait();
+    flush_nodes();
 
-            // Aspiration window checks
-            if (currentBestScore <= low) {
-                // fail low → widen down
-                if (window >= INF / 2) {
-                    alpha = -INF; beta = INF;
-                } else {
-                    window = std::min(window * 2, INF / 2);
-                    alpha = prevScore - window;
-                    beta  = prevScore + window;
-                }
-                // reset scores before retry
-                currentBestScore = -INF;
-                currentBestMove = Move();
-                continue;
-            } else if (currentBestScore >= high) {
-                // fail high → widen up
-                if (window >= INF / 2) {
-                    alpha = -INF; beta = INF;
-                } else {
-                    window = std::min(window * 2, INF / 2);
-                    alpha = prevScore - window;
-                    beta  = prevScore + window;
-                }
-                // reset scores before retry
-                currentBestScore = -INF;
-                currentBestMove = Move();
-                continue;
-            } else {
-                // success
-                prevScore = currentBestScore;
-                bestMove = currentBestMove;
-                haveScore = true;
-                break;
-            }
-        }
+    // The main thread decides: take the deepest completed iteration, preferring its own result on ties
+    const RootResult *best = &main;
+    for (auto &r : results) {
+        if (r.depth > best->depth) best = &r;
     }
-TIMEOUT:
-    return bestMove;
+    // stopped before even depth 1 finished: any legal move beats none
+    if (best->bestMove == Move() && rootMoves.size() > 0) return *rootMoves.begin();
+    return best->bestMove;
+}
+
+template<Color Us>
+Move find_best_move(Board &p, const SearchLimits &limits) {
+    resize_pool();
+    Move best;
+    searchPool[0]->run([&] { best = main_search<Us>(p, limits); });
+    searchPool[0]->wait();
+    return best;
 }
 
-template int quiescence<WHITE>(Position&, int, int);
-template int quiescence<BLACK>(Position&, int, int);
-template int parallel_alphabeta_pvs<WHITE>(Position&, int, int, int, bool, bool);
-template int parallel_alphabeta_pvs<BLACK>(Position&, int, int, int, bool, bool);
-template Move find_best_move<WHITE>(Position&, int, int);
-template Move find_best_move<BLACK>(Position&, int, int);
\ No newline at end of file
+template int quiescence<WHITE>(Board&, int, int);
+template int quiescence<BLACK>(Board&, int, int);
+template int parallel_alphabeta_pvs<WHITE>(Board&, int, int, int, bool, bool);
+template int parallel_alphabeta_pvs<BLACK>(Board&, int, int, int, bool, bool);
+template Move find_best_move<WHITE>(Board&, const SearchLimits&);
+template Move find_best_move<BLACK>(Board&, const SearchLimits&);
+template vector<Move> principal_variation<WHITE>(Board&, Move, int);
+template vector<Move> principal_variation<BLACK>(Board&, Move, int);
\ No newline at end of file
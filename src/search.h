@@ -9,14 +9,52 @@
 
 #include "eval.h"
 #include "../lib/surge/src/position.h"
+#include "Board.h"
+#include "TimeManager.h"
+#include <vector>
 
 template<Color Us>
-int quiescence(Position &p, int alpha, int beta);
+int quiescence(Board &p, int alpha, int beta);
 
 template<Color Us>
-int parallel_alphabeta_pvs(Position &p, int depth, int alpha, int beta, bool tryParallel, bool tryCache);
+int parallel_alphabeta_pvs(Board &p, int depth, int alpha, int beta, bool tryParallel, bool tryCache);
 
+// Iterative deepening within the given limits; returns the best move of the deepest completed iteration.
+// Call prepare_search first.
 template<Color Us>
-Move find_best_move(Position &p, int depth, int timeLimitMs = 1000);
+Move find_best_move(Board &p, const SearchLimits &limits);
+
+// Clears the stop flag of the last search and starts the clock of the next one. Whoever may stop the next
+// search or send it a ponderhit calls it before starting that search, so that a stop or ponderhit sent
+// before the search thread got going is not lost.
+void prepare_search(const SearchLimits &limits);
+
+// Stops a running search as soon as possible; find_best_move then returns its best move so far
+void stop_search();
+
+// Nodes searched by the current or last search, over all threads
+uint64_t searched_nodes();
+
+// The opponent played the move we pondered on: the search continues under its normal time limits
+void ponderhit();
+
+// best followed by the moves the transposition table expects, at most maxLength moves in total
+template<Color Us>
+std::vector<Move> principal_variation(Board &p, Move best, int maxLength);
+
+// Forgets everything learned in earlier searches: the transposition table and the history, killers, evaluation
+// cache and pawn hash of every search thread
+void clear_search();
+
+// Print an info line after every iteration (the default)
+void set_search_output(bool enabled);
+
+// Number of Lazy SMP threads used by find_best_move, including the one of the main search
+void set_search_threads(int n);
+int get_search_threads();
+
+// Use YBWC split points on the work-stealing pool instead of Lazy SMP helper threads
+void set_split_points(bool enabled);
+bool get_split_points();
 
 #endif //CHESS_SEARCH_H
\ No newline at end of file
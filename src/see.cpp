@@ -0,0 +1,102 @@
+//
+// Created by fabian on 10/18/26.
+//
+
+#include "see.h"
+#include "eval.h"
+#include "sliders.h"
+
+#include <algorithm>
+
+static inline int type_value(PieceType pt) {
+    return piece_value(make_piece(WHITE, pt));
+}
+
+// All pieces of both colours attacking s, kings included (attackers_from leaves them out)
+static inline Bitboard all_attackers(const Position &p, Square s, Bitboard occ) {
+    return p.attackers_from<WHITE>(s, occ) | p.attackers_from<BLACK>(s, occ)
+         | (attacks<KING>(s, occ) & (p.bitboard_of(WHITE_KING) | p.bitboard_of(BLACK_KING)));
+}
+
+int see(const Position &p, Move m) {
+    const MoveFlags f = m.flags();
+    if (!(f & CAPTURE) && f != PR_QUEEN) return 0;
+
+    const Square from = m.from();
+    const Square to = m.to();
+    Piece moving = p.at(from);
+    Color side = color_of(moving);
+
+    Bitboard occ = p.all_pieces<WHITE>() | p.all_pieces<BLACK>();
+    int gain[32];
+    int d = 0;
+
+    if (f == EN_PASSANT) {
+        gain[0] = type_value(PAWN);
+        occ ^= SQUARE_BB[create_square(file_of(to), rank_of(from))];
+    } else {
+        gain[0] = p.at(to) == NO_PIECE ? 0 : piece_value(p.at(to));
+    }
+
+    // the piece standing on the target square after the move
+    int onSquare = type_value(type_of(moving));
+    if (f == PR_QUEEN || f == PC_QUEEN) {
+        gain[0] += type_value(QUEEN) - type_value(PAWN);
+        onSquare = type_value(QUEEN);
+    }
+
+    const Bitboard diag = p.bitboard_of(WHITE_BISHOP) | p.bitboard_of(BLACK_BISHOP)
+                        | p.bitboard_of(WHITE_QUEEN) | p.bitboard_of(BLACK_QUEEN);
+    const Bitboard orth = p.bitboard_of(WHITE_ROOK) | p.bitboard_of(BLACK_ROOK)
+                        | p.bitboard_of(WHITE_QUEEN) | p.bitboard_of(BLACK_QUEEN);
+
+    occ ^= SQUARE_BB[from];
+    Bitboard attackers = all_attackers(p, to, occ) & occ;
+
+    while (true) {
+        side = ~side;
+        Bitboard ours = attackers & (side == WHITE ? p.all_pieces<WHITE>() : p.all_pieces<BLACK>());
+        if (!ours) break;
+
+        // least valuable attacker
+        PieceType pt = PAWN;
+        Bitboard bb = 0;
+        for (; pt <= KING; pt = PieceType(pt + 1)) {
+            bb = ours & p.bitboard_of(side, pt);
+            if (bb) break;
+        }
+
+        // the king may only recapture if the square is no longer defended
+        if (pt == KING && (attackers & ~ours)) break;
+
+        d++;
+        gain[d] = onSquare - gain[d - 1];
+        onSquare = type_value(pt);
+
+        occ ^= bb & -bb;
+        // sliders behind the piece that just captured join in
+        if (pt == PAWN || pt == BISHOP || pt == QUEEN) attackers |= slider_attacks<BISHOP>(to, occ) & diag;
+        if (pt == ROOK || pt == QUEEN) attackers |= slider_attacks<ROOK>(to, occ) & orth;
+        attackers &= occ;
+
+        if (d == 31) break;
+    }
+
+    while (d > 0) {
+        gain[d - 1] = -std::max(-gain[d - 1], gain[d]);
+        d--;
+    }
+    return gain[0];
+}
+
+bool see_ge(const Position &p, Move m, int threshold) {
+    const MoveFlags f = m.flags();
+    if (!(f & CAPTURE) && f != PR_QUEEN) return 0 >= threshold;
+
+    // taking something at least as valuable as the capturing piece can never lose material
+    Piece moving = p.at(m.from());
+    int victim = f == EN_PASSANT ? type_value(PAWN) : (p.at(m.to()) == NO_PIECE ? 0 : piece_value(p.at(m.to())));
+    if (type_of(moving) != KING && victim - piece_value(moving) >= threshold) return true;
+
+    return see(p, m) >= threshold;
+}
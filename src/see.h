@@ -0,0 +1,20 @@
+//
+// Created by fabian on 10/18/26.
+//
+
+#ifndef CHESS_SEE_H
+#define CHESS_SEE_H
+
+#pragma once
+
+#include "../lib/surge/src/position.h"
+
+// Static exchange evaluation: the material balance (in piece_value units) for the side making the
+// capture m after the best sequence of recaptures on m.to(), each side always recapturing with its
+// least valuable attacker. Pins are ignored. Quiet moves return 0.
+int see(const Position &p, Move m);
+
+// Cheaper test for see(p, m) >= threshold, which is all that move ordering and pruning need
+bool see_ge(const Position &p, Move m, int threshold = 0);
+
+#endif //CHESS_SEE_H
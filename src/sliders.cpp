@@ -0,0 +1,101 @@
+//
+// Created by fabian on 10/18/26.
+//
+
+#include "sliders.h"
+
+#ifdef SLIDERS_PEXT
+#include <cpuid.h>
+#include <cstring>
+#endif
+
+// Entries of all rook squares (102400) and all bishop squares (5248)
+static constexpr size_t PEXT_ENTRIES = 102400 + 5248;
+
+PextSquare PEXT_ROOK[NSQUARES];
+PextSquare PEXT_BISHOP[NSQUARES];
+uint16_t PEXT_ATTACKS[PEXT_ENTRIES];
+
+// BMI2 is in CPUID leaf 7. AMD implements PEXT in microcode before Zen 3 (family 19h), at hundreds of
+// cycles per instruction, so those CPUs keep the magics.
+static bool fast_pext() {
+#ifdef SLIDERS_PEXT
+    unsigned eax, ebx, ecx, edx;
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) || !(ebx & bit_BMI2)) return false;
+
+    char vendor[13] = {};
+    __get_cpuid(0, &eax, &ebx, &ecx, &edx);
+    std::memcpy(vendor, &ebx, 4);
+    std::memcpy(vendor + 4, &edx, 4);
+    std::memcpy(vendor + 8, &ecx, 4);
+    if (std::strcmp(vendor, "AuthenticAMD") == 0) {
+        __get_cpuid(1, &eax, &ebx, &ecx, &edx);
+        const unsigned family = ((eax >> 8) & 0xf) + ((eax >> 20) & 0xff);
+        if (family < 0x19) return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+const bool usePext = fast_pext();
+
+const char *slider_lookup_name() {
+    return usePext ? "pext" : "magic";
+}
+
+#ifdef SLIDERS_PEXT
+
+// Squares reached from s in the given directions until and including the first occupied square
+static Bitboard ray_attacks(Square s, Bitboard occ, const int (&dirs)[4][2]) {
+    Bitboard a = 0;
+    for (const auto &d : dirs) {
+        for (int f = file_of(s) + d[0], r = rank_of(s) + d[1]; f >= 0 && f < 8 && r >= 0 && r < 8; f += d[0], r += d[1]) {
+            a |= SQUARE_BB[r * 8 + f];
+            if (occ & SQUARE_BB[r * 8 + f]) break;
+        }
+    }
+    return a;
+}
+
+// _pext_u64 in plain C++, so that building the tables needs no BMI2
+static uint64_t pext_soft(uint64_t x, uint64_t mask) {
+    uint64_t out = 0;
+    for (uint64_t bit = 1; mask; mask &= mask - 1, bit <<= 1) {
+        if (x & mask & -mask) out |= bit;
+    }
+    return out;
+}
+
+static uint32_t init_piece(PextSquare (&table)[NSQUARES], const int (&dirs)[4][2], uint32_t offset) {
+    for (int sq = 0; sq < 64; ++sq) {
+        const Square s = Square(sq);
+        // the last square of a ray is attacked whether it is occupied or not
+        const Bitboard edges = ((MASK_RANK[RANK1] | MASK_RANK[RANK8]) & ~MASK_RANK[rank_of(s)])
+                               | ((MASK_FILE[AFILE] | MASK_FILE[HFILE]) & ~MASK_FILE[file_of(s)]);
+        PextSquare &e = table[sq];
+        e.attacks = ray_attacks(s, 0, dirs);
+        e.mask = e.attacks & ~edges;
+        e.offset = offset;
+
+        // every subset of the mask, by the carry-rippler trick
+        Bitboard occ = 0;
+        do {
+            PEXT_ATTACKS[offset + pext_soft(occ, e.mask)] = uint16_t(pext_soft(ray_attacks(s, occ, dirs), e.attacks));
+            occ = (occ - e.mask) & e.mask;
+        } while (occ);
+        offset += uint32_t(1) << pop_count(e.mask);
+    }
+    return offset;
+}
+
+static const bool pext_initialised = [] {
+    if (!usePext) return false;
+    static const int rookDirs[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+    static const int bishopDirs[4][2] = {{1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+    init_piece(PEXT_BISHOP, bishopDirs, init_piece(PEXT_ROOK, rookDirs, 0));
+    return true;
+}();
+
+#endif
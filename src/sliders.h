@@ -0,0 +1,73 @@
+//
+// Created by fabian on 10/18/26.
+//
+
+#ifndef CHESS_SLIDERS_H
+#define CHESS_SLIDERS_H
+
+#pragma once
+
+#include "../lib/surge/src/tables.h"
+#include "../lib/surge/src/types.h"
+#include <cstdint>
+
+// Only builds that may use BMI2 everywhere (x86-64-v3 and later) inline the PEXT lookup. A call out of line
+// per lookup makes it slower than the magics (SliderBench), so other builds keep the magics.
+#if defined(__x86_64__) && defined(__BMI2__)
+#include <immintrin.h>
+#define SLIDERS_PEXT
+#endif
+
+// Bishop, rook and queen attacks for the engine's own lookups (evaluation, exchange evaluation). In builds
+// with BMI2, on CPUs with a fast PEXT instruction, they come from tables indexed by _pext_u64 of the
+// occupancy; elsewhere, including AMD CPUs before Zen 3, which run PEXT in microcode, from surge's magic
+// bitboards. CPUID decides once at startup.
+//
+// The tables are compact: an entry holds the attack set squeezed into the bits of the empty board attacks
+// of its square (at most 14 for a rook), and _pdep_u64 spreads it out again. That takes 16 bits instead of
+// 64 per entry, 210 KB for all squares, which fits in L2 next to the rest of the engine's tables; surge's
+// magic tables take 2.3 MB.
+
+struct PextSquare {
+    Bitboard mask;          // relevant occupancy: the empty board attacks without the last square of each ray
+    Bitboard attacks;       // empty board attacks, the bits an entry is deposited into
+    uint32_t offset;        // of the square's entries in PEXT_ATTACKS
+};
+
+extern PextSquare PEXT_ROOK[NSQUARES];
+extern PextSquare PEXT_BISHOP[NSQUARES];
+extern uint16_t PEXT_ATTACKS[];
+
+// Whether the PEXT tables are used, decided by CPUID
+extern const bool usePext;
+
+// "pext" or "magic"
+const char *slider_lookup_name();
+
+template<PieceType P>
+inline Bitboard slider_attacks(Square s, Bitboard occ) {
+    static_assert(P == BISHOP || P == ROOK || P == QUEEN, "slider_attacks takes bishops, rooks and queens");
+    if constexpr (P == QUEEN) {
+        return slider_attacks<BISHOP>(s, occ) | slider_attacks<ROOK>(s, occ);
+    } else {
+#ifdef SLIDERS_PEXT
+        if (usePext) {
+            const PextSquare &e = P == ROOK ? PEXT_ROOK[s] : PEXT_BISHOP[s];
+            return _pdep_u64(PEXT_ATTACKS[e.offset + _pext_u64(occ, e.mask)], e.attacks);
+        }
+#endif
+        return attacks<P>(s, occ);
+    }
+}
+
+// Attacks of any piece but a pawn, like surge's attacks(pt, s, occ)
+inline Bitboard piece_attacks(PieceType pt, Square s, Bitboard occ) {
+    switch (pt) {
+        case BISHOP: return slider_attacks<BISHOP>(s, occ);
+        case ROOK: return slider_attacks<ROOK>(s, occ);
+        case QUEEN: return slider_attacks<QUEEN>(s, occ);
+        default: return attacks(pt, s, occ);
+    }
+}
+
+#endif //CHESS_SLIDERS_H
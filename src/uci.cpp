@@ -0,0 +1,279 @@
+//
+// Created by fabian on 10/18/26.
+//
+
+#include "uci.h"
+
+#include <algorithm>
+#include <charconv>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+
+#include "EndgameDB.h"
+#include "NNUE.h"
+#include "OpeningDB.h"
+#include "SearchStats.h"
+#include "TranspositionTable.h"
+#include "bench.h"
+#include "eval.h"
+#include "search.h"
+
+using namespace std;
+
+extern TranspositionTable TT;
+extern EndgameDB endgame_db;
+extern OpeningDB opening_db;
+
+static const string START_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+string move_to_uci(Move m) {
+    if (m == Move()) return "0000";
+    Square to = m.to();
+    if (m.flags() == OO) to = m.from() == e1 ? g1 : g8;
+    string s = string(SQSTR[m.from()]) + SQSTR[to];
+    if (m.flags() & PR_KNIGHT) s += "nbrq"[m.flags() & 0b11];
+    return s;
+}
+
+template<Color Us>
+static Move find_uci_move(Board &b, const string &s) {
+    MoveList<Us> moves(b);
+    for (Move m : moves) {
+        if (move_to_uci(m) == s) return m;
+    }
+    return Move();
+}
+
+Move parse_uci_move(Board &b, const string &s) {
+    return b.turn() == WHITE ? find_uci_move<WHITE>(b, s) : find_uci_move<BLACK>(b, s);
+}
+
+// State shared between the command loop and the search thread
+static unique_ptr<Board> board;
+static thread searchThread;
+static mutex outputMutex;
+static condition_variable bestMoveReleased;
+static bool holdBestMove = false;   // infinite and ponder searches may only answer after stop or ponderhit
+
+static void wait_for_search() {
+    if (searchThread.joinable()) searchThread.join();
+}
+
+static void stop() {
+    {
+        lock_guard<mutex> lock(outputMutex);
+        holdBestMove = false;
+    }
+    bestMoveReleased.notify_all();
+    stop_search();
+    wait_for_search();
+}
+
+template<Color Us>
+static void search_and_answer(Board *b, SearchLimits limits) {
+    Move best = find_best_move<Us>(*b, limits);
+    vector<Move> pv = principal_variation<Us>(*b, best, 2);
+
+    unique_lock<mutex> lock(outputMutex);
+    bestMoveReleased.wait(lock, [] { return !holdBestMove; });
+    cout << "bestmove " << move_to_uci(best);
+    if (pv.size() > 1) cout << " ponder " << move_to_uci(pv[1]);
+    cout << endl;
+}
+
+// Start searches from a fresh copy of b, so that the whole state stack is available to them; the keys of
+// the game so far go along for the repetition checks
+static void set_root(const Board &b) {
+    auto root = make_unique<Board>();
+    Board::set(b.fen(), *root);
+    root->set_prior_keys(b.game_keys());
+    board = std::move(root);
+}
+
+static void position(istringstream &is) {
+    string token, fen;
+    is >> token;
+    if (token == "startpos") {
+        fen = START_FEN;
+        is >> token; // "moves", if any
+    } else if (token == "fen") {
+        while (is >> token && token != "moves") fen += token + " ";
+    } else {
+        return;
+    }
+
+    board = make_unique<Board>();
+    Board::set(fen, *board);
+    while (is >> token) {
+        Move m = parse_uci_move(*board, token);
+        if (m == Move()) break;
+        if (board->turn() == WHITE) board->play<WHITE>(m);
+        else board->play<BLACK>(m);
+        // a board holds 256 plies of state, long games are replayed in pieces
+        if (board->ply() >= 128) set_root(*board);
+    }
+    set_root(*board);
+}
+
+static void go(istringstream &is) {
+    SearchLimits limits;
+    string token;
+    while (is >> token) {
+        if (token == "wtime") is >> limits.timeLeftMs[WHITE];
+        else if (token == "btime") is >> limits.timeLeftMs[BLACK];
+        else if (token == "winc") is >> limits.incrementMs[WHITE];
+        else if (token == "binc") is >> limits.incrementMs[BLACK];
+        else if (token == "movestogo") is >> limits.movesToGo;
+        else if (token == "depth") is >> limits.depth;
+        else if (token == "nodes") is >> limits.nodes;
+        else if (token == "movetime") is >> limits.moveTimeMs;
+        else if (token == "infinite") limits.infinite = true;
+        else if (token == "ponder") limits.ponder = true;
+    }
+
+    holdBestMove = limits.infinite || limits.ponder;
+    prepare_search(limits);
+    Board *b = board.get();
+    if (b->turn() == WHITE) searchThread = thread(search_and_answer<WHITE>, b, limits);
+    else searchThread = thread(search_and_answer<BLACK>, b, limits);
+}
+
+// Parses an integer and clamps it to [lo, hi]. False if text is not an integer.
+static bool parse_int(const string &text, int lo, int hi, int &out) {
+    long long v;
+    const char *end = text.data() + text.size();
+    auto [ptr, ec] = from_chars(text.data(), end, v);
+    if (ec != errc() || ptr != end) return false;
+    out = int(clamp<long long>(v, lo, hi));
+    return true;
+}
+
+// Value of a spin option within the range announced by "uci"; false and a message if it is not a number
+static bool spin_value(const string &name, const string &value, int lo, int hi, int &out) {
+    if (!parse_int(value, lo, hi, out)) {
+        cout << "info string " << name << " needs a number from " << lo << " to " << hi << ", not '" << value << "'" << endl;
+        return false;
+    }
+    if (to_string(out) != value) cout << "info string " << name << " set to " << out << endl;
+    return true;
+}
+
+static void set_option(istringstream &is) {
+    string token, name, value;
+    is >> token; // "name"
+    while (is >> token && token != "value") name += (name.empty() ? "" : " ") + token;
+    while (is >> token) value += (value.empty() ? "" : " ") + token;
+
+    int n;
+    if (name == "Hash") {
+        if (spin_value(name, value, 1, 65536, n)) TT.resize(size_t(n));
+    } else if (name == "Threads") {
+        if (spin_value(name, value, 1, 512, n)) set_search_threads(n);
+    } else if (name == "SplitPoints") {
+        set_split_points(value == "true");
+    } else if (name == "SyzygyPath") {
+        endgame_db.load(value == "<empty>" ? "" : value);
+    } else if (name == "SyzygyProbeDepth") {
+        if (spin_value(name, value, 1, 100, n)) endgame_db.set_probe_depth(n);
+    } else if (name == "BookFile") {
+        if (value != "<empty>" && !opening_db.load(value)) cout << "info string cannot read book " << value << endl;
+    } else if (name == "EvalFile") {
+        bool loaded = value != "<empty>" && nnue.load(value);
+        set_use_nnue(loaded);
+        cout << "info string " << (loaded ? "NNUE evaluation using " + value : "classical evaluation") << endl;
+    } else if (name == "EvalParams") {
+        // <empty> goes back to the built-in weights
+        EvalParams params = default_eval_params();
+        if (value != "<empty>" && !load_eval_params(value, params)) {
+            cout << "info string cannot read evaluation parameters " << value << endl;
+        } else {
+            apply_eval_params(params);
+            // the material sums of the board were built with the old weights
+            set_root(*board);
+        }
+    } else if (name != "Ponder") {
+        cout << "info string unknown option " << name << endl;
+    }
+}
+
+void uci_loop() {
+    board = make_unique<Board>();
+    Board::set(START_FEN, *board);
+
+    string line, cmd;
+    while (getline(cin, line)) {
+        istringstream is(line);
+        cmd.clear();
+        is >> cmd;
+
+        if (cmd == "uci") {
+            cout << "id name Wombat\n"
+                 << "id author fabian\n"
+                 << "option name Hash type spin default 64 min 1 max 65536\n"
+                 << "option name Threads type spin default " << get_search_threads() << " min 1 max 512\n"
+                 << "option name SplitPoints type check default false\n"
+                 << "option name Ponder type check default false\n"
+                 << "option name SyzygyPath type string default <empty>\n"
+                 << "option name SyzygyProbeDepth type spin default 1 min 1 max 100\n"
+                 << "option name BookFile type string default <empty>\n"
+                 << "option name EvalFile type string default <empty>\n"
+                 << "option name EvalParams type string default <empty>\n"
+                 << "uciok" << endl;
+        } else if (cmd == "isready") {
+            cout << "readyok" << endl;
+        } else if (cmd == "ucinewgame") {
+            stop();
+            clear_search();
+        } else if (cmd == "setoption") {
+            stop();
+            set_option(is);
+        } else if (cmd == "position") {
+            stop();
+            position(is);
+        } else if (cmd == "go") {
+            stop();
+            go(is);
+        } else if (cmd == "stop") {
+            stop();
+        } else if (cmd == "ponderhit") {
+            // the search goes on under the normal time limits and answers as soon as it is done
+            ponderhit();
+            {
+                lock_guard<mutex> lock(outputMutex);
+                holdBestMove = false;
+            }
+            bestMoveReleased.notify_all();
+        } else if (cmd == "bench") {
+            // bench [depth] [threads] [hash MB] [split]; leaves the table at the bench size
+            int depth = 8, threads = 1, hashMb = 16;
+            bool splitPoints = false;
+            string token;
+            bool valid = true;
+            if (is >> token) valid = parse_int(token, 1, 64, depth);
+            if (valid && is >> token) valid = parse_int(token, 1, 512, threads);
+            if (valid && is >> token) valid = parse_int(token, 1, 65536, hashMb);
+            if (valid && is >> token) splitPoints = token == "split";
+            if (!valid) {
+                cout << "info string usage: bench [depth 1-64] [threads 1-512] [hash MB 1-65536] [split]" << endl;
+                continue;
+            }
+            stop();
+            bench(depth, threads, hashMb, splitPoints);
+        } else if (cmd == "stats") {
+            // counters of the last search, see SearchStats.h
+            stop();
+            stats::print(cout, stats::collect());
+        } else if (cmd == "d") {
+            // the search plays its moves on the same board
+            stop();
+            cout << *board << endl;
+        } else if (cmd == "quit") {
+            break;
+        }
+    }
+    stop();
+}
@@ -0,0 +1,24 @@
+//
+// Created by fabian on 10/18/26.
+//
+
+#ifndef CHESS_UCI_H
+#define CHESS_UCI_H
+
+#pragma once
+
+#include "../lib/surge/src/position.h"
+#include "Board.h"
+#include <string>
+
+// Reads UCI commands from stdin until "quit". Searches run on their own thread, so "stop",
+// "ponderhit" and "isready" are answered while the engine is thinking.
+void uci_loop();
+
+// Long algebraic notation as UCI expects it; surge encodes short castling as e1h1, UCI wants e1g1
+std::string move_to_uci(Move m);
+
+// The legal move of b written as s in UCI notation, or Move() if there is none
+Move parse_uci_move(Board &b, const std::string &s);
+
+#endif //CHESS_UCI_H
@@ -2,400 +2,632 @@
 // Created by fabian on 9/21/25.
 //
 
-// build_opening_db.cpp
-// Compile and link with your engine code that defines Position, Move, types.h, tables.h, etc.
+// create_openings.cpp
+// Builds the opening book from PGN files: counts how often every move was played in the first plies of
+// every game and writes the most frequent positions with all their moves (see OpeningDB.h).
+//
+//   Openings <pgn-file-or-directory> <output-book> [max_positions] [--threads N] [--plies N]
+//            [--memory MB] [--tmp DIR] [--append BOOK]
+//
+// The PGN files are memory-mapped and cut into chunks at game boundaries. Worker threads take chunks from
+// a shared queue, parse them in place and count into their own tables, which are split into shards by
+// position key. When the tables outgrow the memory budget they are written to disk as sorted runs, so
+// the memory use does not depend on the size of the input. At the end every shard is merged over all
+// runs on its own thread with a k-way merge.
+//
+// --append adds the counts of an existing book (usually the output file itself) as one more run. Only
+// the positions that made it into that book survive, so keep max_positions generous for books that are
+// meant to grow month by month.
 
 #include <bits/stdc++.h>
 #include <filesystem>
-#include <regex>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "../lib/surge/src/position.h"
+#include "../src/OpeningDB.h"
 
 using namespace std;
 namespace fs = std::filesystem;
 
-static inline string square_to_string(Square s) {
-    int sq = int(s);
-    int file = sq % 8;
-    int rank = sq / 8;
-    string out;
-    out.push_back(char('a' + file));
-    out.push_back(char('1' + rank));
-    return out;
-}
-
-static string move_to_uci(const Move &m) {
-    string s = square_to_string(m.from()) + square_to_string(m.to());
-    switch (m.flags()) {
-        case PR_KNIGHT: s.push_back('n'); break;
-        case PR_BISHOP: s.push_back('b'); break;
-        case PR_ROOK:   s.push_back('r'); break;
-        case PR_QUEEN:  s.push_back('q'); break;
-        default: break;
+static const string START_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq -";
+static constexpr size_t CHUNK_SIZE = 8 << 20;
+static constexpr int SHARD_BITS = 6;
+static constexpr int SHARDS = 1 << SHARD_BITS;
+
+// ----------------- SAN -----------------
+
+static PieceType piece_of_letter(char c) {
+    switch (c) {
+        case 'N': return KNIGHT;
+        case 'B': return BISHOP;
+        case 'R': return ROOK;
+        case 'Q': return QUEEN;
+        case 'K': return KING;
+        default: return PAWN;
     }
-    return s;
-}
-
-// Minimal piece-letter mapping used in SAN generation (uppercase for piece types except pawn)
-static char piece_letter(Piece pc) {
-    if (pc == NO_PIECE) return '?';
-    PieceType pt = type_of(pc);
-    switch (pt) {
-        case KING: return 'K';
-        case QUEEN: return 'Q';
-        case ROOK: return 'R';
-        case BISHOP: return 'B';
-        case KNIGHT: return 'N';
-        case PAWN: return '\0';
-    }
-    return '\0';
-}
-
-// Trim helper
-static inline string trim(const string &s) {
-    size_t a = 0;
-    while (a < s.size() && isspace((unsigned char)s[a])) ++a;
-    size_t b = s.size();
-    while (b > a && isspace((unsigned char)s[b-1])) --b;
-    return s.substr(a, b-a);
 }
 
 template<Color Us>
-static bool resolve_san_to_move(Position &pos, const string &san_token, Move &resolved) {
-    if (san_token == "1-0" || san_token == "0-1" || san_token == "1/2-1/2" || san_token == "*")
-        return false;
+static bool resolve_san_to_move(Position &pos, string_view san, Move &resolved) {
+    // Strip check, mate and annotation marks
+    while (!san.empty() && (san.back() == '+' || san.back() == '#' || san.back() == '!' || san.back() == '?'))
+        san.remove_suffix(1);
+    if (san.size() < 2) return false;
 
-    // Strip + and # from SAN
-    string token = san_token;
-    while (!token.empty() && (token.back() == '+' || token.back() == '#'))
-        token.pop_back();
+    MoveList<Us> moves(pos);
 
     // Handle castling explicitly
-    string lower = token;
-    transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
-    if (lower == "o-o" || lower == "0-0") {
-        MoveList<Us> moves(pos);
-        for (auto &m : moves) {
-            if (m.flags() == OO) { resolved = m; return true; }
+    if (san == "O-O" || san == "0-0" || san == "O-O-O" || san == "0-0-0") {
+        MoveFlags flag = san.size() == 3 ? OO : OOO;
+        for (Move m : moves) {
+            if (m.flags() == flag) { resolved = m; return true; }
         }
         return false;
     }
-    if (lower == "o-o-o" || lower == "0-0-0") {
-        MoveList<Us> moves(pos);
-        for (auto &m : moves) {
-            if (m.flags() == OOO) { resolved = m; return true; }
+
+    PieceType pt = piece_of_letter(san[0]);
+    size_t start = pt == PAWN ? 0 : 1;
+
+    // Promotion, written as e8=Q or e8Q; the piece index follows surge's flags: knight 0 .. queen 3
+    int promotion = -1;
+    if (pt == PAWN) {
+        PieceType promoted = piece_of_letter(san.back());
+        if (promoted != PAWN && promoted != KING) {
+            promotion = promoted - KNIGHT;
+            san.remove_suffix(1);
+            if (!san.empty() && san.back() == '=') san.remove_suffix(1);
         }
-        return false;
     }
+    if (san.size() < start + 2) return false;
+
+    // Destination square
+    char df = san[san.size() - 2], dr = san[san.size() - 1];
+    if (df < 'a' || df > 'h' || dr < '1' || dr > '8') return false;
+    Square to = create_square(File(df - 'a'), Rank(dr - '1'));
 
-    char piece_char = 'P';
-    bool has_piece = false;
-    if (isupper(token[0]) && token[0] != 'O') {
-        piece_char = token[0];
-        has_piece = true;
+    // Optional disambiguation (file/rank or pawn file in capture)
+    int fromFile = -1, fromRank = -1;
+    for (size_t i = start; i + 2 < san.size(); ++i) {
+        char c = san[i];
+        if (c >= 'a' && c <= 'h') fromFile = c - 'a';
+        else if (c >= '1' && c <= '8') fromRank = c - '1';
     }
-    size_t start_idx = 0;
-    if (isupper(token[0]) && token[0] != 'O') {
-        piece_char = token[0];
-        start_idx = 1;
+
+    for (Move m : moves) {
+        if (m.to() != to || m.flags() == OO || m.flags() == OOO) continue;
+        if (type_of(pos.at(m.from())) != pt) continue;
+        if (fromFile >= 0 && file_of(m.from()) != fromFile) continue;
+        if (fromRank >= 0 && rank_of(m.from()) != fromRank) continue;
+        bool isPromotion = m.flags() & PR_KNIGHT;
+        if (isPromotion != (promotion >= 0)) continue;
+        if (isPromotion && (m.flags() & 0b11) != promotion) continue;
+
+        resolved = m;
+        return true;
     }
+    return false;
+}
 
-    // Optional disambiguation (file/rank or pawn file in capture)
-    char disamb_file = '\0';
-    char disamb_rank = '\0';
-    for (size_t i = start_idx; i < token.size(); i++) {
-        if (token[i] == 'x') continue;
-        if (i+1 < token.size() && isalpha(token[i]) && isdigit(token[i+1]))
-            break; // hit destination square
-        if (isalpha(token[i]) && islower(token[i]))
-            disamb_file = token[i];
-        else if (isdigit(token[i]))
-            disamb_rank = token[i];
-    }
-
-    // Try to match by destination square and promotion
-    string dest;
-    if (token.size() >= 2 && isalpha(token[token.size()-2]) && isdigit(token[token.size()-1]))
-        dest = token.substr(token.size()-2);
-
-    char promo = '\0';
-    if (token.find('=') != string::npos)
-        promo = toupper(token.back());
-    else if (token.size() > 2 && isalpha(token.back()) && isupper(token.back()))
-        promo = token.back();
+// ----------------- Counting -----------------
 
-    MoveList<Us> moves(pos);
-    for (auto &m : moves) {
-        string to = square_to_string(m.to());
-        if (!dest.empty() && to != dest) continue;
-
-        if (promo) {
-            if (m.flags() == PR_QUEEN && promo != 'Q') continue;
-            if (m.flags() == PR_ROOK  && promo != 'R') continue;
-            if (m.flags() == PR_BISHOP&& promo != 'B') continue;
-            if (m.flags() == PR_KNIGHT&& promo != 'N') continue;
-        }
+struct MoveKey {
+    uint64_t hash;
+    uint16_t move;
+    bool operator==(const MoveKey &o) const { return hash == o.hash && move == o.move; }
+};
 
-        char pl = piece_letter(pos.at(m.from()));
-        if (has_piece) {
-            // Token specifies a piece, must match exactly
-            if (pl != token[0]) continue;
-        } else {
-            // Token does not specify a piece, must be a pawn move
-            if (pl != '\0') continue;
+struct MoveKeyHash {
+    size_t operator()(const MoveKey &k) const { return k.hash ^ (uint64_t(k.move) * 0x9E3779B97F4A7C15ULL); }
+};
+
+using CountTable = unordered_map<MoveKey, uint32_t, MoveKeyHash>;
+
+// Roughly what one table entry costs, node and bucket included
+static constexpr size_t BYTES_PER_COUNT = 64;
+
+// Counts of one thread, split by the top bits of the position key
+struct ThreadTally {
+    CountTable shards[SHARDS];
+    uint64_t games = 0;
+    size_t counts = 0;          // entries in all shards
+    vector<fs::path> runs;      // spilled so far
+
+    void add(uint64_t hash, Move m) {
+        auto [it, inserted] = shards[hash >> (64 - SHARD_BITS)].try_emplace(MoveKey{hash, OpeningDB::encode_move(m)}, 0);
+        it->second++;
+        counts += inserted;
+    }
+
+    // Writes all counts to a run, a book file without weights sorted by key, and empties the tables.
+    // The shards are in key order already, so each one is sorted and written on its own.
+    bool spill(const fs::path &path) {
+        ofstream ofs(path, ios::binary);
+        vector<BookEntry> entries;
+        vector<unsigned char> buffer;
+        for (CountTable &shard : shards) {
+            entries.clear();
+            entries.reserve(shard.size());
+            for (auto &kv : shard) entries.push_back({kv.first.hash, kv.first.move, 0, kv.second});
+            CountTable().swap(shard);
+            sort(entries.begin(), entries.end(), [](const BookEntry &a, const BookEntry &b) { return a.key < b.key; });
+
+            buffer.resize(entries.size() * OpeningDB::RECORD_SIZE);
+            for (size_t i = 0; i < entries.size(); ++i) {
+                OpeningDB::write_record(buffer.data() + i * OpeningDB::RECORD_SIZE, entries[i]);
+            }
+            ofs.write(reinterpret_cast<const char *>(buffer.data()), streamsize(buffer.size()));
         }
+        counts = 0;
+        runs.push_back(path);
+        return bool(ofs);
+    }
+};
 
-        if (disamb_file && file_of(m.from()) != disamb_file - 'a')
-            continue;
-        if (disamb_rank && rank_of(m.from()) != disamb_rank - '1')
-            continue;
+// ----------------- PGN parsing -----------------
 
-        resolved = m;
-        return true;
+// Plays the moves of one game from the start position and counts them. The position is reset by
+// undoing the moves, which is cheaper than setting up a new one for every game.
+class GameReader {
+public:
+    GameReader(ThreadTally &tally, int maxPlies) : tally(tally), maxPlies(maxPlies) {
+        Position::set(START_FEN, pos);
+        played.reserve(maxPlies);
     }
 
+    void start_game() {
+        end_game();
+        active = true;
+        tally.games++;
+    }
 
-    for (auto &m : moves) {
-        cout << m << " ";
+    void end_game() {
+        for (auto it = played.rbegin(); it != played.rend(); ++it) {
+            if (pos.turn() == WHITE) pos.undo<BLACK>(*it);
+            else pos.undo<WHITE>(*it);
+        }
+        played.clear();
+        active = false;
     }
-    cout << endl;
 
-    return false;
-}
+    void token(string_view tok) {
+        if (!active) return;
+        if (tok == "1-0" || tok == "0-1" || tok == "1/2-1/2" || tok == "*") {
+            active = false;
+            return;
+        }
+        // move numbers, also when glued to the move as in "12.Nf3" or "12...Nf6"; "0-0" is castling
+        if ((isdigit((unsigned char)tok[0]) || tok[0] == '.') && tok.rfind("0-0", 0) != 0) {
+            size_t i = 0;
+            while (i < tok.size() && (isdigit((unsigned char)tok[i]) || tok[i] == '.')) ++i;
+            tok.remove_prefix(i);
+            if (tok.empty()) return;
+        }
 
-// Tokenize PGN movetext into SAN tokens (ignores move numbers and comments)
+        Move m;
+        bool ok = pos.turn() == WHITE ? resolve_san_to_move<WHITE>(pos, tok, m)
+                                      : resolve_san_to_move<BLACK>(pos, tok, m);
+        if (!ok) {
+            // Skipping rest of game
+            active = false;
+            return;
+        }
+        tally.add(pos.get_hash(), m);
 
-static vector<string> tokenize_movetext(const string &movetext) {
-    vector<string> tokens;
-    string cur;
-    for (size_t i = 0; i < movetext.size(); ++i) {
-        char c = movetext[i];
-        if (c == '{') {
-            // skip comment until '}'
-            while (i < movetext.size() && movetext[i] != '}') ++i;
+        if (pos.turn() == WHITE) pos.play<WHITE>(m);
+        else pos.play<BLACK>(m);
+        played.push_back(m);
+        if (int(played.size()) >= maxPlies) active = false;
+    }
+
+private:
+    ThreadTally &tally;
+    int maxPlies;
+    Position pos;
+    vector<Move> played;
+    bool active = false;
+};
+
+static inline bool is_token_end(char c) {
+    return isspace((unsigned char)c) || c == '{' || c == '}' || c == '(' || c == ')' || c == ';' || c == '$';
+}
+
+// Parses the games in [p, end) without copying: tag lines start a game, comments, variations and
+// NAGs are skipped, everything else is handed to the reader as a token
+static void parse_games(const char *p, const char *end, GameReader &reader) {
+    bool lineStart = true;
+    bool inMovetext = false;
+
+    while (p < end) {
+        char c = *p;
+        if (c == '\n') {
+            lineStart = true;
+            ++p;
             continue;
         }
-        if (c == '(') {
-            // skip variations (naive: skip until matching ')')
-            int depth = 1;
-            ++i;
-            while (i < movetext.size() && depth > 0) {
-                if (movetext[i] == '(') ++depth;
-                else if (movetext[i] == ')') --depth;
-                ++i;
-            }
-            --i;
+        if (lineStart && c == '[') {
+            // a tag line; the first one after movetext belongs to the next game
+            if (inMovetext) reader.end_game();
+            inMovetext = false;
+            p = static_cast<const char *>(memchr(p, '\n', end - p));
+            if (!p) break;
             continue;
         }
-        // whitespace or move-number or results separate tokens
+        lineStart = false;
+
         if (isspace((unsigned char)c)) {
-            if (!cur.empty()) {
-                tokens.push_back(cur);
-                cur.clear();
-            }
+            ++p;
             continue;
         }
-        if (c == '.' ) {
-            // skip periods in move numbers like "1." or "1..."
-            if (!cur.empty()) {
-                tokens.push_back(cur);
-                cur.clear();
-            }
-            // skip contiguous dots
-            continue;
+        if (!inMovetext) {
+            reader.start_game();
+            inMovetext = true;
         }
 
-        // normal character into current token
-        cur.push_back(c);
-    }
-    if (!cur.empty()) tokens.push_back(cur);
-    // Remove move numbers like "1.", "23." and tokens like "1-0" we'll treat as results
-    vector<string> out;
-    std::regex move_num_only(R"(^\d+$|^\d+\.+$)");
-    std::regex move_num_with_move(R"(^\d+\.+([a-zA-Z].*)$)");
-    std::smatch m;
-    for (auto &t : tokens) {
-        if (std::regex_match(t, move_num_only)) continue;
-        if (std::regex_match(t, m, move_num_with_move)) {
-            out.push_back(m[1]);
-            continue;
+        if (c == '{') {
+            // skip comment until '}'
+            const char *close = static_cast<const char *>(memchr(p, '}', end - p));
+            p = close ? close + 1 : end;
+        } else if (c == ';') {
+            // comment until the end of the line
+            const char *nl = static_cast<const char *>(memchr(p, '\n', end - p));
+            p = nl ? nl : end;
+        } else if (c == '(') {
+            // skip variations, which may be nested
+            int depth = 0;
+            for (; p < end; ++p) {
+                if (*p == '(') ++depth;
+                else if (*p == ')' && --depth == 0) { ++p; break; }
+                else if (*p == '{') {
+                    const char *close = static_cast<const char *>(memchr(p, '}', end - p));
+                    if (!close) { p = end; break; }
+                    p = close;
+                }
+            }
+        } else if (c == '$' || c == ')' || c == '}') {
+            // numeric annotation glyph or an unbalanced bracket
+            ++p;
+            while (p < end && !is_token_end(*p)) ++p;
+        } else {
+            const char *q = p;
+            while (q < end && !is_token_end(*q)) ++q;
+            reader.token(string_view(p, size_t(q - p)));
+            p = q;
         }
-        out.push_back(t);
     }
-    return out;
+    reader.end_game();
 }
 
-// ----------------- PGN parsing -----------------
+// ----------------- Files and chunks -----------------
+
+struct MappedFile {
+    fs::path path;
+    const char *data = nullptr;
+    size_t size = 0;
+};
 
-// Read whole file into string
-static bool read_file_to_string(const fs::path &p, string &out) {
-    ifstream ifs(p, ios::in | ios::binary);
-    if (!ifs) return false;
-    std::ostringstream ss;
-    ss << ifs.rdbuf();
-    out = ss.str();
+static bool map_file(MappedFile &f) {
+    int fd = open(f.path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st{};
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+    f.size = size_t(st.st_size);
+    if (f.size == 0) {
+        close(fd);
+        return true;
+    }
+    void *map = mmap(nullptr, f.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return false;
+    madvise(map, f.size, MADV_SEQUENTIAL);
+    f.data = static_cast<const char *>(map);
     return true;
 }
 
-// Extract tokens of header and movetext for a single game from a PGN file content starting at pos
-// This function is simple: finds next blank-line-separated game (headers then movetext)
-static bool extract_next_game(const string &filecontent, size_t &pos, string &headers, string &movetext) {
-    size_t n = filecontent.size();
-    if (pos >= n) return false;
-    // Skip leading whitespace
-    while (pos < n && isspace((unsigned char)filecontent[pos])) ++pos;
-    if (pos >= n) return false;
-
-    // Headers: consecutive lines beginning with '['
-    headers.clear();
-    movetext.clear();
-    while (pos < n) {
-        size_t line_end = filecontent.find('\n', pos);
-        if (line_end == string::npos) line_end = n;
-        string line = filecontent.substr(pos, line_end - pos);
-        if (!line.empty() && line[0] == '[') {
-            headers += line + '\n';
-            pos = line_end + 1;
-        } else break;
-    }
-
-    // Now movetext until a blank line separating games or EOF
-    bool any = false;
-    while (pos < n) {
-        size_t line_end = filecontent.find('\n', pos);
-        if (line_end == string::npos) line_end = n;
-        string line = filecontent.substr(pos, line_end - pos);
-        // blank line that separates games
-        if (trim(line).empty()) {
-            pos = line_end + 1;
-            if (any) break;
-            else continue;
+struct Chunk {
+    const char *begin;
+    const char *end;
+};
+
+// The first game that starts at or after offset: a tag line that follows a blank line
+static size_t next_game_start(const char *data, size_t size, size_t offset) {
+    if (offset == 0) return 0;
+    for (size_t i = offset; i < size; ++i) {
+        if (data[i] != '\n' || i + 1 >= size || data[i + 1] != '[') continue;
+        // is the line that ends here blank?
+        size_t j = i;
+        while (j > 0 && (data[j - 1] == '\r' || data[j - 1] == ' ' || data[j - 1] == '\t')) --j;
+        if (j == 0 || data[j - 1] == '\n') return i + 1;
+    }
+    return size;
+}
+
+static void split_into_chunks(const MappedFile &f, vector<Chunk> &chunks) {
+    size_t begin = 0;
+    while (begin < f.size) {
+        size_t end = next_game_start(f.data, f.size, min(f.size, begin + CHUNK_SIZE));
+        chunks.push_back({f.data + begin, f.data + end});
+        begin = end;
+    }
+}
+
+static vector<fs::path> find_pgn_files(const fs::path &input) {
+    vector<fs::path> files;
+    if (fs::is_regular_file(input)) {
+        files.push_back(input);
+        return files;
+    }
+    // Iterate over .pgn files
+    for (auto &entry : fs::recursive_directory_iterator(input)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".pgn") files.push_back(entry.path());
+    }
+    sort(files.begin(), files.end());
+    return files;
+}
+
+// ----------------- Merging -----------------
+
+// All moves of one position with their counts summed over all runs
+struct PositionGroup {
+    uint64_t key = 0;
+    uint64_t total = 0;
+    vector<pair<uint16_t, uint64_t>> moves;
+};
+
+// The positions reached by the most games, kept in a min-heap of at most limit groups
+class TopPositions {
+public:
+    explicit TopPositions(size_t limit) : limit(limit) {}
+
+    void offer(PositionGroup &&g) {
+        if (limit == 0) return;
+        if (heap.size() == limit) {
+            if (g.total <= heap.front().total) return;
+            pop_heap(heap.begin(), heap.end(), more_games);
+            heap.pop_back();
         }
-        movetext += line + ' ';
-        any = true;
-        pos = line_end + 1;
+        heap.push_back(std::move(g));
+        push_heap(heap.begin(), heap.end(), more_games);
     }
 
-    return any || !headers.empty();
+    vector<PositionGroup> &groups() { return heap; }
+
+private:
+    static bool more_games(const PositionGroup &a, const PositionGroup &b) { return a.total > b.total; }
+
+    size_t limit;
+    vector<PositionGroup> heap;
+};
+
+static inline uint64_t run_key(const MappedFile &run, size_t i) {
+    return OpeningDB::read_record(reinterpret_cast<const unsigned char *>(run.data) + i * OpeningDB::RECORD_SIZE).key;
 }
 
-// ----------------- Main tallying logic -----------------
+// First record of a run with a key >= key; records have a fixed size, so this is a plain binary search
+static size_t run_lower_bound(const MappedFile &run, uint64_t key) {
+    size_t lo = 0, hi = run.size / OpeningDB::RECORD_SIZE;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (run_key(run, mid) < key) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
 
-int main(int argc, char** argv) {
+// k-way merge of the part of every run that belongs to one shard
+static void merge_shard(int shard, const vector<MappedFile> &runs, TopPositions &top) {
+    const uint64_t first = uint64_t(shard) << (64 - SHARD_BITS);
+    struct Cursor {
+        size_t next, end;
+    };
+    vector<Cursor> cursors(runs.size());
+    // smallest key first, with the index of its run
+    priority_queue<pair<uint64_t, size_t>, vector<pair<uint64_t, size_t>>, greater<>> queue;
+    for (size_t r = 0; r < runs.size(); ++r) {
+        cursors[r].next = run_lower_bound(runs[r], first);
+        cursors[r].end = shard + 1 < SHARDS ? run_lower_bound(runs[r], first + (uint64_t(1) << (64 - SHARD_BITS)))
+                                            : runs[r].size / OpeningDB::RECORD_SIZE;
+        if (cursors[r].next < cursors[r].end) queue.emplace(run_key(runs[r], cursors[r].next), r);
+    }
 
-    if (argc < 3) {
-        cerr << "Usage: " << argv[0] << " <pgn-directory> <output-csv> [max_positions]\n";
-        return 2;
+    PositionGroup group;
+    while (!queue.empty()) {
+        auto [key, r] = queue.top();
+        queue.pop();
+        if (key != group.key && !group.moves.empty()) {
+            top.offer(std::move(group));
+            group = PositionGroup();
+        }
+        group.key = key;
+
+        const auto *record = reinterpret_cast<const unsigned char *>(runs[r].data) + cursors[r].next * OpeningDB::RECORD_SIZE;
+        BookEntry e = OpeningDB::read_record(record);
+        // books from elsewhere may only carry weights
+        uint64_t count = e.count ? e.count : e.weight;
+        auto it = find_if(group.moves.begin(), group.moves.end(), [&](auto &m) { return m.first == e.move; });
+        if (it == group.moves.end()) group.moves.emplace_back(e.move, count);
+        else it->second += count;
+        group.total += count;
+
+        if (++cursors[r].next < cursors[r].end) queue.emplace(run_key(runs[r], cursors[r].next), r);
     }
-    fs::path pgn_dir = argv[1];
-    string out_csv = argv[2];
+    if (!group.moves.empty()) top.offer(std::move(group));
+}
+
+// ----------------- Main tallying logic -----------------
+
+static int usage(const char *name) {
+    cerr << "Usage: " << name << " <pgn-file-or-directory> <output-book> [max_positions] [--threads N] [--plies N]\n"
+         << "       [--memory MB] [--tmp DIR] [--append BOOK]\n";
+    return 2;
+}
+
+int main(int argc, char **argv) {
     size_t max_positions = 100000;
-    if (argc >= 4) max_positions = stoull(argv[3]);
+    int threads = max(1u, thread::hardware_concurrency());
+    int maxPlies = 18;
+    size_t memoryMb = 2048;
+    string tmpDir, appendBook;
+    vector<string> args;
+    for (int i = 1; i < argc; ++i) {
+        string a = argv[i];
+        if (a == "--threads" && i + 1 < argc) threads = max(1, atoi(argv[++i]));
+        else if (a == "--plies" && i + 1 < argc) maxPlies = max(1, atoi(argv[++i]));
+        else if (a == "--memory" && i + 1 < argc) memoryMb = max(1, atoi(argv[++i]));
+        else if (a == "--tmp" && i + 1 < argc) tmpDir = argv[++i];
+        else if (a == "--append" && i + 1 < argc) appendBook = argv[++i];
+        else if (a.rfind("--", 0) == 0) return usage(argv[0]);
+        else args.push_back(a);
+    }
+    if (args.size() < 2) return usage(argv[0]);
+    fs::path input = args[0];
+    string out_book = args[1];
+    if (args.size() >= 3) max_positions = stoull(args[2]);
+
+    fs::path runDir = tmpDir.empty() ? fs::path(out_book + ".runs") : fs::path(tmpDir);
+    error_code ec;
+    // the directories this run creates, deepest first; a --tmp directory that already exists is left alone
+    vector<fs::path> createdDirs;
+    for (fs::path d = fs::absolute(runDir, ec); !d.empty() && !fs::exists(d, ec); d = d.parent_path()) {
+        createdDirs.push_back(d);
+    }
+    fs::create_directories(runDir, ec);
+    if (ec) {
+        cerr << "Cannot create " << runDir << ": " << ec.message() << "\n";
+        return 3;
+    }
 
     zobrist::initialise_zobrist_keys();
     initialise_all_databases();
 
-    // Map from position-hash -> map move_uci -> count
-    unordered_map<uint64_t, unordered_map<string, uint32_t>> db;
-    db.reserve(1<<20);
+    auto startTime = chrono::steady_clock::now();
 
-    // Also track overall frequencies of positions
-    unordered_map<uint64_t, uint64_t> pos_freq;
-    pos_freq.reserve(1<<20);
-
-    // Iterate over .pgn files
-    for (auto& entry : fs::recursive_directory_iterator(pgn_dir)) {
-        if (!entry.is_regular_file()) continue;
-        if (entry.path().extension() != ".pgn") continue;
-
-        string filecontent;
-        if (!read_file_to_string(entry.path(), filecontent)) {
-            cerr << "Warning: failed to read " << entry.path() << "\n";
+    vector<MappedFile> files;
+    vector<Chunk> chunks;
+    size_t totalBytes = 0;
+    for (const fs::path &path : find_pgn_files(input)) {
+        MappedFile f{path};
+        if (!map_file(f)) {
+            cerr << "Warning: failed to read " << path << "\n";
             continue;
         }
+        split_into_chunks(f, chunks);
+        totalBytes += f.size;
+        files.push_back(f);
+    }
 
-        size_t pos = 0;
-        string headers, movetext;
-        size_t games_in_file = 0;
-        while (extract_next_game(filecontent, pos, headers, movetext)) {
-            ++games_in_file;
-            // Tokenize movetext
-            vector<string> tokens = tokenize_movetext(movetext);
-            // Initialize starting position (standard chess start)
-            Position cur;
-            Position::set("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq -", cur);
-
-            int tlen = tokens.size();
-            tlen = tlen <  18 ? tlen : 18;
-            for (size_t t = 0; t < tlen; ++t) {
-                string tok = trim(tokens[t]);
-                if (tok.empty()) continue;
-                // Record current position hash (before applying move)
-                uint64_t h = cur.get_hash();
-                pos_freq[h] += 1;
-
-                // Resolve SAN token to Move
-                Move m;
-                bool ok = cur.turn() == WHITE ? resolve_san_to_move<WHITE>(cur, tok, m) : resolve_san_to_move<BLACK>(cur, tok, m);
-                if (!ok) {
-                    /*cout << cur << endl;
-                    cout << headers << endl;
-                    cout << movetext  << endl << flush;
-                    cout << "Warning: couldn't resolve SAN '" << tok << "' in file " << entry.path()
-                         << " (game " << games_in_file << "). Skipping rest of game.\n" << endl;
-                    for (auto t : tokens) cout << t << " ";
-                    cout << endl;*/
-                    break;
-                }
-                // increment move count for this position
-                string uci = move_to_uci(m);
-                db[h][uci] += 1;
-
-                // Play move
-                if (cur.turn() == WHITE) cur.play<WHITE>(m);
-                else cur.play<BLACK>(m);
-            }
+    // Workers take chunks from the queue until it is empty and spill whenever their share of the
+    // memory budget is used up; a chunk adds at most a few MB before the next check
+    const size_t countsPerThread = max<size_t>(1, memoryMb * (1 << 20) / BYTES_PER_COUNT / threads);
+    vector<ThreadTally> tallies(threads);
+    atomic<size_t> nextChunk{0};
+    atomic<bool> writeFailed{false};
+    auto work = [&](int id) {
+        ThreadTally &tally = tallies[id];
+        auto spill = [&] {
+            fs::path path = runDir / ("run-" + to_string(id) + "-" + to_string(tally.runs.size()) + ".bin");
+            if (!tally.spill(path)) writeFailed = true;
+        };
+        GameReader reader(tally, maxPlies);
+        for (size_t i = nextChunk++; i < chunks.size(); i = nextChunk++) {
+            parse_games(chunks[i].begin, chunks[i].end, reader);
+            if (tally.counts > countsPerThread) spill();
         }
-        cout << "Processed " << games_in_file << " games in " << entry.path() << "\n";
+        if (tally.counts > 0) spill();
+    };
+    vector<thread> pool;
+    for (int id = 0; id < threads; ++id) pool.emplace_back(work, id);
+    for (auto &t : pool) t.join();
+    pool.clear();
+
+    for (auto &f : files) {
+        if (f.data) munmap(const_cast<char *>(f.data), f.size);
     }
 
-    // Now select top max_positions by pos_freq
-    vector<pair<uint64_t, uint64_t>> freq_list;
-    freq_list.reserve(pos_freq.size());
-    for (auto &p : pos_freq) freq_list.emplace_back(p.first, p.second);
-    sort(freq_list.begin(), freq_list.end(), [](auto &a, auto &b){ return a.second > b.second; });
-
-    if (freq_list.size() > max_positions) freq_list.resize(max_positions);
-
-    // Write CSV header and rows
-    ofstream ofs(out_csv);
-    if (!ofs) {
-        cout << "Failed to open output file " << out_csv << "\n";
+    uint64_t games = 0;
+    vector<MappedFile> runs;
+    for (auto &t : tallies) {
+        games += t.games;
+        for (auto &path : t.runs) runs.push_back(MappedFile{path});
+    }
+    double parseSeconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+    cout << "Processed " << games << " games in " << files.size() << " files, " << totalBytes / (1 << 20) << " MB in "
+         << fixed << setprecision(2) << parseSeconds << " s (" << totalBytes / (1 << 20) / max(parseSeconds, 1e-9)
+         << " MB/s), " << runs.size() << " runs\n";
+
+    auto cleanup = [&] {
+        for (auto &t : tallies) for (auto &path : t.runs) fs::remove(path, ec);
+        for (auto &d : createdDirs) fs::remove(d, ec); // only if it is empty
+    };
+    if (writeFailed) {
+        cerr << "Failed to write runs to " << runDir << "\n";
+        cleanup();
         return 3;
     }
-    ofs << "hash,total_occurrences,move1_uci,move1_count,move2_uci,move2_count,move3_uci,move3_count\n";
-
-    for (auto &p : freq_list) {
-        uint64_t h = p.first;
-        uint64_t total_occ = p.second;
 
-        // get move counts for this position and pick top 3
-        vector<pair<string,uint32_t>> moves;
-        auto it = db.find(h);
-        if (it != db.end()) {
-            for (auto &kv : it->second) moves.emplace_back(kv.first, kv.second);
-            sort(moves.begin(), moves.end(), [](auto &a, auto &b){ return a.second > b.second; });
+    if (!appendBook.empty()) {
+        MappedFile book{appendBook};
+        if (!map_file(book) || book.size % OpeningDB::RECORD_SIZE != 0) {
+            cerr << "Cannot read book " << appendBook << "\n";
+            cleanup();
+            return 3;
+        }
+        runs.push_back(book);
+    }
+    for (auto &run : runs) {
+        if (!run.data && !map_file(run)) {
+            cerr << "Cannot read run " << run.path << "\n";
+            cleanup();
+            return 3;
         }
+    }
 
-        // pad to 3 moves
-        while (moves.size() < 3) moves.emplace_back(string(), 0);
+    // Merge: the shards are independent, so the threads take them one at a time, each keeping its own
+    // top positions; those are combined at the end
+    vector<TopPositions> tops(threads, TopPositions(max_positions));
+    atomic<int> nextShard{0};
+    auto merge = [&](int id) {
+        for (int s = nextShard++; s < SHARDS; s = nextShard++) merge_shard(s, runs, tops[id]);
+    };
+    for (int id = 0; id < threads; ++id) pool.emplace_back(merge, id);
+    for (auto &t : pool) t.join();
+
+    TopPositions &top = tops[0];
+    for (int id = 1; id < threads; ++id) {
+        for (auto &g : tops[id].groups()) top.offer(std::move(g));
+        tops[id].groups().clear();
+    }
 
-        ofs << h << "," << total_occ << ","
-            << moves[0].first << "," << moves[0].second << ","
-            << moves[1].first << "," << moves[1].second << ","
-            << moves[2].first << "," << moves[2].second << "\n";
+    // the book to append to may be the output file, it has to be unmapped before it is overwritten
+    for (auto &run : runs) {
+        if (run.data) munmap(const_cast<char *>(run.data), run.size);
+    }
+    cleanup();
+
+    // Every move of the selected positions becomes a book entry. Weights are 16 bits wide, so the counts of
+    // a position whose top move was played more often than that are scaled down together.
+    vector<BookEntry> entries;
+    for (const PositionGroup &g : top.groups()) {
+        uint64_t most = 0;
+        for (auto &m : g.moves) most = max(most, m.second);
+        for (auto &m : g.moves) {
+            BookEntry e;
+            e.key = g.key;
+            e.move = m.first;
+            e.count = uint32_t(min<uint64_t>(m.second, UINT32_MAX));
+            e.weight = uint16_t(most <= 65535 ? m.second : max<uint64_t>(1, m.second * 65535 / most));
+            entries.push_back(e);
+        }
     }
 
-    ofs.close();
-    cout << "Wrote " << freq_list.size() << " positions to " << out_csv << "\n";
+    if (!OpeningDB::write(out_book, entries)) {
+        cout << "Failed to write output file " << out_book << "\n";
+        return 3;
+    }
+    cout << "Wrote " << entries.size() << " moves of " << top.groups().size() << " positions to " << out_book << "\n";
     return 0;
 }
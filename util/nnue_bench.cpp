@@ -0,0 +1,82 @@
+//
+// Created by fabian on 10/18/26.
+//
+
+// nnue_bench.cpp
+// Compares the throughput of the classical evaluation and the NNUE: walks the move tree of a few positions to a
+// fixed depth with Board::play/undo and evaluates every node, once with each evaluator.
+//
+//   NNUEBench <net.nnue> [depth]
+
+#include <bits/stdc++.h>
+#include "../lib/surge/src/position.h"
+#include "../src/Board.h"
+#include "../src/eval.h"
+#include "../src/NNUE.h"
+
+using namespace std;
+
+static const char *BENCH_FENS[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq -",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -",
+    "1rq2rk1/pb1nbp1p/2p1p1p1/3nP3/Np1PQ3/1P1B1NP1/P1R2P1P/2BR2K1 b - -",
+    "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP2BPPP/R2QKB1R w KQ -",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - -",
+    "4rrk1/pp1n3p/3q2pQ/2p1pb2/2PP4/2P3N1/P2B2PP/4RRK1 b - -",
+};
+
+// Sum of all evaluations of a run: printed, so that the compiler has to compute them, and equal between
+// builds that evaluate alike
+static int64_t evalSum = 0;
+
+template<Color Us>
+static uint64_t walk(Board &b, int depth) {
+    evalSum += evaluate<Us>(b);
+    if (depth == 0) return 1;
+
+    uint64_t nodes = 1;
+    MoveList<Us> moves(b);
+    for (Move m : moves) {
+        b.play<Us>(m);
+        nodes += walk<~Us>(b, depth - 1);
+        b.undo<Us>(m);
+    }
+    return nodes;
+}
+
+static void run(const char *name, int depth) {
+    uint64_t nodes = 0;
+    evalSum = 0;
+    auto start = chrono::steady_clock::now();
+    for (const char *fen : BENCH_FENS) {
+        Board b;
+        Board::set(fen, b);
+        nodes += b.turn() == WHITE ? walk<WHITE>(b, depth) : walk<BLACK>(b, depth);
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << left << setw(10) << name << nodes << " nodes  " << fixed << setprecision(2) << seconds << " s  "
+         << uint64_t(nodes / max(seconds, 1e-9)) << " nps  sum " << evalSum << "\n";
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        cerr << "usage: " << argv[0] << " <net.nnue> [depth]\n";
+        return 1;
+    }
+    int depth = argc > 2 ? atoi(argv[2]) : 3;
+
+    initialise_all_databases();
+    zobrist::initialise_zobrist_keys();
+
+    if (!nnue.load(argv[1])) {
+        cerr << "Could not load network " << argv[1] << "\n";
+        return 1;
+    }
+    cout << "NNUE kernels: " << NNUE::simd_name() << "\n";
+
+    set_use_nnue(false);
+    run("classical", depth);
+    set_use_nnue(true);
+    run("nnue", depth);
+    return 0;
+}
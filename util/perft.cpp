@@ -0,0 +1,264 @@
+//
+// Created by fabian on 10/18/26.
+//
+
+// perft.cpp
+// Counts the leaf nodes of the legal move tree with surge's move generator. Used to validate changes to
+// surge against known node counts and to measure the raw speed of move generation.
+//
+//   Perft [options] <depth> [fen]     count, the starting position if no FEN is given
+//   Perft [options] suite             check the known-answer positions below
+//
+// Options:
+//   --divide       print the count below every root move
+//   --threads N    search the root moves on N threads (default: all cores)
+//   --hash MB      cache subtree counts in a shared hash table of MB megabytes (default: off)
+//   --no-bulk      make and unmake the last ply as well instead of counting the generated moves
+
+#include <bits/stdc++.h>
+#include "../lib/surge/src/position.h"
+
+using namespace std;
+
+static const string START_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+struct KnownAnswer {
+    const char *fen;
+    int depth;
+    uint64_t nodes;
+};
+
+// The standard positions from the chess programming wiki and a set of en passant, castling and promotion
+// traps; every one of them has caught a move generator bug somewhere
+static const KnownAnswer SUITE[] = {
+    {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 6, 119060324},
+    {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 5, 193690690},
+    {"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 6, 11030083},
+    {"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 5, 15833292},
+    {"r2q1rk1/pP1p2pp/Q4n2/bbp1p3/Np6/1B3NBn/pPPP1PPP/R3K2R b KQ - 0 1", 5, 15833292},
+    {"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 5, 89941194},
+    {"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 5, 164075551},
+    {"3k4/3p4/8/K1P4r/8/8/8/8 b - - 0 1", 6, 1134888},
+    {"8/8/4k3/8/2p5/8/B2P2K1/8 w - - 0 1", 6, 1015133},
+    {"8/8/1k6/2b5/2pP4/8/5K2/8 b - d3 0 1", 6, 1440467},
+    {"5k2/8/8/8/8/8/8/4K2R w K - 0 1", 6, 661072},
+    {"3k4/8/8/8/8/8/8/R3K3 w Q - 0 1", 6, 803711},
+    {"r3k2r/1b4bq/8/8/8/8/7B/R3K2R w KQkq - 0 1", 4, 1274206},
+    {"r3k2r/8/3Q4/8/8/5q2/8/R3K2R b KQkq - 0 1", 4, 1720476},
+    {"2K2r2/4P3/8/8/8/8/8/3k4 w - - 0 1", 6, 3821001},
+    {"8/8/1P2K3/8/2n5/1q6/8/5k2 b - - 0 1", 5, 1004658},
+    {"4k3/1P6/8/8/8/8/K7/8 w - - 0 1", 6, 217342},
+    {"8/P1k5/K7/8/8/8/8/8 w - - 0 1", 6, 92683},
+    {"K1k5/8/P7/8/8/8/8/8 w - - 0 1", 6, 2217},
+    {"8/k1P5/8/1K6/8/8/8/8 w - - 0 1", 7, 567584},
+    {"8/8/2k5/5q2/5n2/8/5K2/8 b - - 0 1", 4, 23527},
+};
+
+// Lock-free cache of subtree counts, shared by all threads. A slot holds the count and (key ^ count),
+// so a torn write looks like a miss, as in the transposition table.
+class PerftHash {
+public:
+    explicit PerftHash(size_t mb) {
+        size_t bytes = max<size_t>(mb, 1) * 1024 * 1024;
+        size_t count = 1;
+        while (count * 2 * sizeof(Slot) <= bytes) count *= 2;
+        slots = make_unique<Slot[]>(count);
+        mask = count - 1;
+    }
+
+    bool probe(uint64_t key, uint64_t &nodes) const {
+        const Slot &s = slots[key & mask];
+        uint64_t n = s.nodes.load(memory_order_relaxed);
+        uint64_t check = s.check.load(memory_order_relaxed);
+        if ((check ^ n) != key) return false;
+        nodes = n;
+        return true;
+    }
+
+    void store(uint64_t key, uint64_t nodes) {
+        Slot &s = slots[key & mask];
+        s.nodes.store(nodes, memory_order_relaxed);
+        s.check.store(key ^ nodes, memory_order_relaxed);
+    }
+
+private:
+    struct Slot {
+        atomic<uint64_t> check{0};
+        atomic<uint64_t> nodes{0};
+    };
+
+    unique_ptr<Slot[]> slots;
+    size_t mask = 0;
+};
+
+struct PerftOptions {
+    bool bulk = true;
+    PerftHash *hash = nullptr;
+};
+
+static inline uint64_t mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    return x ^ (x >> 33);
+}
+
+// Squares whose "moved" bit in UndoInfo::entry decides the castling rights
+static constexpr Bitboard CASTLING_SQUARES = 0x9100000000000091ULL;
+
+// surge's zobrist key only covers the pieces and the side to move. Two positions with the same pieces
+// but different castling rights or en passant squares have different subtrees, so both are mixed in,
+// together with the remaining depth.
+static inline uint64_t perft_key(const Position &p, int depth) {
+    const UndoInfo &u = p.history[p.ply()];
+    return p.get_hash() ^ mix((u.entry & CASTLING_SQUARES) | (uint64_t(u.epsq) << 8) | (uint64_t(depth) << 16));
+}
+
+template<Color Us>
+static uint64_t perft(Position &p, int depth, const PerftOptions &opt) {
+    MoveList<Us> moves(p);
+    if (depth == 1 && opt.bulk) return moves.size();
+
+    uint64_t key = 0, nodes = 0;
+    if (opt.hash && depth > 1) {
+        key = perft_key(p, depth);
+        if (opt.hash->probe(key, nodes)) return nodes;
+    }
+
+    for (Move m : moves) {
+        p.play<Us>(m);
+        nodes += depth == 1 ? 1 : perft<~Us>(p, depth - 1, opt);
+        p.undo<Us>(m);
+    }
+
+    if (opt.hash && depth > 1) opt.hash->store(key, nodes);
+    return nodes;
+}
+
+static string move_string(Move m) {
+    Square to = m.to();
+    if (m.flags() == OO) to = m.from() == e1 ? g1 : g8;   // surge encodes short castling as king takes rook
+    string s = string(SQSTR[m.from()]) + SQSTR[to];
+    if (m.flags() & PR_KNIGHT) s += "nbrq"[m.flags() & 0b11];
+    return s;
+}
+
+// The root moves are handed out one at a time from a shared counter, so a thread that drew a small
+// subtree simply takes the next move
+template<Color Us>
+static uint64_t perft_root(const string &fen, int depth, int threads, const PerftOptions &opt, bool divide) {
+    Position root;
+    Position::set(fen, root);
+    MoveList<Us> moves(root);
+    vector<Move> rootMoves(moves.begin(), moves.end());
+    vector<uint64_t> counts(rootMoves.size(), 0);
+
+    if (depth <= 0) return 1;
+
+    atomic<size_t> next{0};
+    auto work = [&] {
+        Position p(root);
+        for (size_t i = next++; i < rootMoves.size(); i = next++) {
+            if (depth == 1) {
+                counts[i] = 1;
+                continue;
+            }
+            p.play<Us>(rootMoves[i]);
+            counts[i] = perft<~Us>(p, depth - 1, opt);
+            p.undo<Us>(rootMoves[i]);
+        }
+    };
+
+    vector<thread> pool;
+    for (int t = 1; t < threads; ++t) pool.emplace_back(work);
+    work();
+    for (auto &t : pool) t.join();
+
+    uint64_t total = 0;
+    for (size_t i = 0; i < rootMoves.size(); ++i) {
+        if (divide) cout << move_string(rootMoves[i]) << ": " << counts[i] << "\n";
+        total += counts[i];
+    }
+    return total;
+}
+
+static uint64_t run_perft(const string &fen, int depth, int threads, const PerftOptions &opt, bool divide) {
+    // the side to move is the second field of the FEN
+    istringstream is(fen);
+    string board, side;
+    is >> board >> side;
+    return side == "b" ? perft_root<BLACK>(fen, depth, threads, opt, divide)
+                       : perft_root<WHITE>(fen, depth, threads, opt, divide);
+}
+
+static void report(uint64_t nodes, double seconds) {
+    cout << "Nodes: " << nodes << "  Time: " << fixed << setprecision(3) << seconds << " s  NPS: "
+         << uint64_t(nodes / max(seconds, 1e-9)) << "\n";
+}
+
+static int run_suite(int threads, const PerftOptions &opt) {
+    int failed = 0;
+    uint64_t totalNodes = 0;
+    auto start = chrono::steady_clock::now();
+
+    for (const KnownAnswer &k : SUITE) {
+        uint64_t nodes = run_perft(k.fen, k.depth, threads, opt, false);
+        totalNodes += nodes;
+        bool ok = nodes == k.nodes;
+        if (!ok) failed++;
+        cout << (ok ? "ok    " : "FAIL  ") << k.fen << "  depth " << k.depth << "  " << nodes;
+        if (!ok) cout << " (expected " << k.nodes << ")";
+        cout << "\n";
+    }
+
+    report(totalNodes, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+    cout << (failed ? to_string(failed) + " of " + to_string(size(SUITE)) + " positions failed"
+                    : "All " + to_string(size(SUITE)) + " positions passed") << endl;
+    return failed ? 1 : 0;
+}
+
+static int usage(const char *name) {
+    cerr << "usage: " << name << " [--divide] [--threads N] [--hash MB] [--no-bulk] <depth> [fen]\n"
+         << "       " << name << " [--threads N] [--hash MB] [--no-bulk] suite\n";
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    initialise_all_databases();
+    zobrist::initialise_zobrist_keys();
+
+    PerftOptions opt;
+    unique_ptr<PerftHash> hash;
+    int threads = max(1u, thread::hardware_concurrency());
+    bool divide = false;
+    vector<string> args;
+
+    for (int i = 1; i < argc; ++i) {
+        string a = argv[i];
+        if (a == "--divide") divide = true;
+        else if (a == "--no-bulk") opt.bulk = false;
+        else if (a == "--threads" && i + 1 < argc) threads = max(1, atoi(argv[++i]));
+        else if (a == "--hash" && i + 1 < argc) hash = make_unique<PerftHash>(size_t(atoi(argv[++i])));
+        else if (a.rfind("--", 0) == 0) return usage(argv[0]);
+        else args.push_back(a);
+    }
+    opt.hash = hash.get();
+
+    if (args.empty()) return usage(argv[0]);
+    if (args[0] == "suite") return run_suite(threads, opt);
+
+    int depth = atoi(args[0].c_str());
+    string fen = START_FEN;
+    if (args.size() > 1) {
+        fen.clear();
+        for (size_t i = 1; i < args.size(); ++i) fen += args[i] + " ";
+    }
+
+    auto start = chrono::steady_clock::now();
+    uint64_t nodes = run_perft(fen, depth, threads, opt, divide);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (divide) cout << "\n";
+    report(nodes, seconds);
+    return 0;
+}
@@ -0,0 +1,111 @@
+//
+// Created by fabian on 10/18/26.
+//
+
+// slider_bench.cpp
+// Times the two slider lookups of src/sliders.h against each other: surge's magic bitboards and the PEXT
+// tables. The squares and occupancies are those of the bishops, rooks and queens of every node of the move
+// trees of a few positions, so the lookups see the boards a search sees. Both lookups must agree.
+//
+//   SliderBench [depth] [rounds]
+//
+// The PEXT tables are only timed in builds with BMI2, which CMake gives SliderBench like Chess-x86-64-v3, and
+// where CPUID enables them.
+
+#include <bits/stdc++.h>
+#include "../lib/surge/src/position.h"
+#include "../src/sliders.h"
+
+using namespace std;
+
+static const char *BENCH_FENS[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq -",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -",
+    "1rq2rk1/pb1nbp1p/2p1p1p1/3nP3/Np1PQ3/1P1B1NP1/P1R2P1P/2BR2K1 b - -",
+    "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP2BPPP/R2QKB1R w KQ -",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - -",
+    "4rrk1/pp1n3p/3q2pQ/2p1pb2/2PP4/2P3N1/P2B2PP/4RRK1 b - -",
+};
+
+struct Lookup {
+    Square s;
+    Bitboard occ;
+};
+
+// Lookups of rook-like and bishop-like attacks
+static vector<Lookup> rookLookups, bishopLookups;
+
+template<Color Us>
+static void walk(Position &p, int depth) {
+    const Bitboard occ = p.all_pieces<WHITE>() | p.all_pieces<BLACK>();
+    for (Color c : {WHITE, BLACK}) {
+        const Bitboard queens = p.bitboard_of(c, QUEEN);
+        for (Bitboard b = p.bitboard_of(c, ROOK) | queens; b; ) rookLookups.push_back({pop_lsb(&b), occ});
+        for (Bitboard b = p.bitboard_of(c, BISHOP) | queens; b; ) bishopLookups.push_back({pop_lsb(&b), occ});
+    }
+    if (depth == 0) return;
+
+    MoveList<Us> moves(p);
+    for (Move m : moves) {
+        p.play<Us>(m);
+        walk<~Us>(p, depth - 1);
+        p.undo<Us>(m);
+    }
+}
+
+// Nanoseconds per lookup of attacks(s, occ) in the fastest of rounds passes over all lookups, which is the
+// one least disturbed by the rest of the machine. The attacks of a pass are summed into sum.
+template<typename Attacks>
+static double time_lookups(const vector<Lookup> &lookups, int rounds, Attacks attacks, Bitboard &sum) {
+    double best = numeric_limits<double>::max();
+    for (int r = 0; r < rounds; ++r) {
+        sum = 0;
+        auto start = chrono::steady_clock::now();
+        for (const Lookup &l : lookups) sum += attacks(l.s, l.occ);
+        best = min(best, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+    }
+    return best * 1e9 / double(lookups.size());
+}
+
+template<PieceType P>
+static bool compare(const char *name, const vector<Lookup> &lookups, int rounds) {
+    Bitboard magicSum = 0, pextSum = 0;
+    double magic = time_lookups(lookups, rounds, [](Square s, Bitboard occ) { return attacks<P>(s, occ); }, magicSum);
+    cout << left << setw(8) << name << setw(8) << "magic" << fixed << setprecision(2) << magic << " ns\n";
+    if (!usePext) return true;
+
+    double pext = time_lookups(lookups, rounds, [](Square s, Bitboard occ) { return slider_attacks<P>(s, occ); },
+                               pextSum);
+    cout << left << setw(8) << name << setw(8) << "pext" << fixed << setprecision(2) << pext << " ns  "
+         << "magic/pext " << setprecision(2) << magic / pext << "\n";
+    if (pextSum != magicSum) {
+        cerr << name << ": the lookups disagree\n";
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    int depth = argc > 1 ? atoi(argv[1]) : 3;
+    int rounds = argc > 2 ? atoi(argv[2]) : 20;
+    if (depth < 0 || rounds < 1) {
+        cerr << "usage: " << argv[0] << " [depth >= 0] [rounds >= 1]\n";
+        return 1;
+    }
+
+    initialise_all_databases();
+    zobrist::initialise_zobrist_keys();
+
+    for (const char *fen : BENCH_FENS) {
+        Position p;
+        Position::set(fen, p);
+        if (p.turn() == WHITE) walk<WHITE>(p, depth);
+        else walk<BLACK>(p, depth);
+    }
+    cout << rookLookups.size() << " rook and " << bishopLookups.size() << " bishop lookups, " << rounds
+         << " rounds, slider lookup: " << slider_lookup_name() << "\n";
+
+    bool agree = compare<ROOK>("rook", rookLookups, rounds);
+    agree &= compare<BISHOP>("bishop", bishopLookups, rounds);
+    return agree ? 0 : 1;
+}
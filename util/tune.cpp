@@ -0,0 +1,334 @@
+//
+// Created by fabian on 10/18/26.
+//
+
+// tune.cpp
+// Texel tuning of the classical evaluation: fits the weights of EvalParams.h to the results of the games that
+// a set of quiet positions was taken from, by minimising the mean squared error between the result and
+// sigmoid(K * eval). The evaluation is linear in the weights, so every position is traced once into the
+// counts of the weights it uses; an epoch is then a pass of multiply-adds over those counts, split across
+// threads, followed by an Adam step over all weights.
+//
+//   Tune [options] <positions>
+//
+// Every line holds a FEN or EPD record and the result of its game for White: 1-0, 0-1 or 1/2-1/2, as is,
+// quoted in an EPD opcode (c9 "1-0";) or as a number in brackets ([1.0], [0.5], [0.0]). Positions in check
+// are skipped, everything else is taken to be quiet.
+//
+// Options:
+//   --threads N    trace and evaluate on N threads (default: all cores)
+//   --epochs N     number of gradient steps (default 500)
+//   --lr X         Adam step size, in units of evaluate() (default 1)
+//   --k X          scaling constant of the sigmoid (default: fitted to the starting weights)
+//   --params FILE  start from these weights instead of the built-in ones
+//   --out FILE     where the weights go, every 50 epochs and at the end (default tuned.params)
+
+#include <bits/stdc++.h>
+#include "../lib/surge/src/position.h"
+#include "../src/Board.h"
+#include "../src/EvalParams.h"
+#include "../src/eval.h"
+
+using namespace std;
+
+constexpr size_t WEIGHTS = 2 * EVAL_PARAM_COUNT;    // the midgame and endgame half of every pair
+
+// A weight that the evaluation of a position used, and how often (White's minus Black's)
+struct Feature {
+    uint16_t index;
+    int16_t count;
+};
+
+struct TunePosition {
+    float result;       // 1 for a White win, 0.5 for a draw, 0 for a loss
+    uint8_t phase;      // clamped to PHASE_MAX
+    uint16_t size;
+    uint64_t first;     // index of the first feature in the shard
+};
+
+// The positions one thread traced, and evaluates in every epoch
+struct Shard {
+    vector<TunePosition> positions;
+    vector<Feature> features;
+    uint64_t skipped = 0;       // no result, an unreadable FEN, or in check
+    uint64_t mismatches = 0;    // the linear model missed the evaluation by more than the rounding
+};
+
+static bool parse_result(const string &s, float &result) {
+    size_t bracket = s.find('[');
+    if (bracket != string::npos) {
+        result = strtof(s.c_str() + bracket + 1, nullptr);
+        return result == 0.0f || result == 0.5f || result == 1.0f;
+    }
+    if (s.find("1/2-1/2") != string::npos) result = 0.5f;
+    else if (s.find("1-0") != string::npos) result = 1.0f;
+    else if (s.find("0-1") != string::npos) result = 0.0f;
+    else return false;
+    return true;
+}
+
+// Splits a line into the four FEN fields, the move counters if present, and the rest
+static bool parse_line(const string &line, string &fen, float &result) {
+    istringstream is(line);
+    string field;
+    fen.clear();
+    for (int i = 0; i < 4; ++i) {
+        if (!(is >> field)) return false;
+        fen += field + " ";
+    }
+    string rest;
+    getline(is, rest);
+    // the half move clock and move number of a full FEN are the only numbers before the result
+    istringstream counters(rest);
+    int halfmove, fullmove;
+    if (counters >> halfmove >> fullmove) fen += to_string(halfmove) + " " + to_string(fullmove);
+    return parse_result(rest, result);
+}
+
+static void trace_line(const string &line, Shard &shard) {
+    string fen;
+    float result = 0;
+    if (!parse_line(line, fen, result)) {
+        shard.skipped++;
+        return;
+    }
+    // Position::set expects an empty board
+    auto board = make_unique<Board>();
+    Board &b = *board;
+    Board::set(fen, b);
+    if (b.turn() == WHITE ? b.in_check<WHITE>() : b.in_check<BLACK>()) {
+        shard.skipped++;
+        return;
+    }
+
+    EvalTrace trace;
+    const int eval = trace_evaluation(b, trace);
+    const int phase = min(b.phase(), PHASE_MAX);
+
+    TunePosition pos{result, uint8_t(phase), 0, shard.features.size()};
+    int64_t mg = 0, eg = 0;
+    for (size_t i = 0; i < EVAL_PARAM_COUNT; ++i) {
+        if (!trace.counts[i]) continue;
+        shard.features.push_back({uint16_t(i), trace.counts[i]});
+        mg += int64_t(trace.counts[i]) * mg_value(eval_params.begin()[i]);
+        eg += int64_t(trace.counts[i]) * eg_value(eval_params.begin()[i]);
+    }
+    pos.size = uint16_t(shard.features.size() - pos.first);
+    shard.positions.push_back(pos);
+
+    // the tapered sum rounds once, the evaluation once more
+    if (abs(double(mg * phase + eg * (PHASE_MAX - phase)) / PHASE_MAX - eval) > 1.0) shard.mismatches++;
+}
+
+// Reads the file in blocks of lines; thread t traces every line i of a block with i % threads == t
+static vector<Shard> load(const string &filename, int threads) {
+    ifstream in(filename);
+    vector<Shard> shards(static_cast<size_t>(threads));
+    if (!in) return shards;
+
+    vector<string> block;
+    auto trace_block = [&] {
+        vector<thread> pool;
+        for (int t = 0; t < threads; ++t) {
+            pool.emplace_back([&, t] {
+                for (size_t i = size_t(t); i < block.size(); i += size_t(threads)) trace_line(block[i], shards[size_t(t)]);
+            });
+        }
+        for (auto &th : pool) th.join();
+        block.clear();
+    };
+
+    string line;
+    while (getline(in, line)) {
+        block.push_back(std::move(line));
+        if (block.size() == size_t(1) << 18) trace_block();
+    }
+    trace_block();
+    return shards;
+}
+
+// Runs f(shard, t) for every shard on its own thread
+template<typename F>
+static void parallel(vector<Shard> &shards, F f) {
+    vector<thread> pool;
+    for (size_t t = 1; t < shards.size(); ++t) pool.emplace_back([&, t] { f(shards[t], t); });
+    f(shards[0], size_t(0));
+    for (auto &th : pool) th.join();
+}
+
+static inline double linear_eval(const Shard &s, const TunePosition &pos, const vector<double> &w) {
+    double mg = 0, eg = 0;
+    for (const Feature *f = s.features.data() + pos.first, *end = f + pos.size; f != end; ++f) {
+        mg += f->count * w[2 * f->index];
+        eg += f->count * w[2 * f->index + 1];
+    }
+    return (mg * pos.phase + eg * (PHASE_MAX - pos.phase)) / PHASE_MAX;
+}
+
+static inline double sigmoid(double k, double eval) {
+    return 1.0 / (1.0 + exp(-k * eval));
+}
+
+// Mean squared error over all positions
+static double loss(vector<Shard> &shards, const vector<double> &w, double k, uint64_t count) {
+    vector<double> sums(shards.size(), 0.0);
+    parallel(shards, [&](const Shard &s, size_t t) {
+        double sum = 0;
+        for (const TunePosition &pos : s.positions) {
+            const double err = pos.result - sigmoid(k, linear_eval(s, pos, w));
+            sum += err * err;
+        }
+        sums[t] = sum;
+    });
+    return accumulate(sums.begin(), sums.end(), 0.0) / double(count);
+}
+
+// Gradient of the mean squared error, each thread summing into its own vector; returns the loss
+static double gradient(vector<Shard> &shards, const vector<double> &w, double k, uint64_t count, vector<double> &grad) {
+    vector<vector<double>> grads(shards.size(), vector<double>(WEIGHTS, 0.0));
+    vector<double> sums(shards.size(), 0.0);
+    parallel(shards, [&](const Shard &s, size_t t) {
+        vector<double> &g = grads[t];
+        double sum = 0;
+        for (const TunePosition &pos : s.positions) {
+            const double sig = sigmoid(k, linear_eval(s, pos, w));
+            const double err = sig - pos.result;
+            sum += err * err;
+            // d(err^2)/d(eval), split between the halves by the phase
+            const double d = 2.0 * err * sig * (1.0 - sig) * k;
+            const double dmg = d * pos.phase / PHASE_MAX, deg = d * (PHASE_MAX - pos.phase) / PHASE_MAX;
+            for (const Feature *f = s.features.data() + pos.first, *end = f + pos.size; f != end; ++f) {
+                g[2 * f->index] += f->count * dmg;
+                g[2 * f->index + 1] += f->count * deg;
+            }
+        }
+        sums[t] = sum;
+    });
+
+    fill(grad.begin(), grad.end(), 0.0);
+    for (const auto &g : grads) {
+        for (size_t i = 0; i < WEIGHTS; ++i) grad[i] += g[i] / double(count);
+    }
+    return accumulate(sums.begin(), sums.end(), 0.0) / double(count);
+}
+
+// The K that makes the starting weights predict the results best. The error is unimodal in K, so a
+// ternary search over a range wide enough for any sensible scale finds it.
+static double fit_k(vector<Shard> &shards, const vector<double> &w, uint64_t count) {
+    double lo = 0.0, hi = 0.01;
+    for (int i = 0; i < 50; ++i) {
+        double m1 = lo + (hi - lo) / 3, m2 = hi - (hi - lo) / 3;
+        if (loss(shards, w, m1, count) < loss(shards, w, m2, count)) hi = m2;
+        else lo = m1;
+    }
+    return (lo + hi) / 2;
+}
+
+static EvalParams to_params(const vector<double> &w) {
+    EvalParams p;
+    for (size_t i = 0; i < EVAL_PARAM_COUNT; ++i) p.begin()[i] = S(int(lround(w[2 * i])), int(lround(w[2 * i + 1])));
+    return p;
+}
+
+static int usage(const char *name) {
+    cerr << "usage: " << name << " [--threads N] [--epochs N] [--lr X] [--k X] [--params FILE] [--out FILE] <positions>\n";
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    initialise_all_databases();
+    zobrist::initialise_zobrist_keys();
+
+    int threads = max(1u, thread::hardware_concurrency());
+    int epochs = 500;
+    double lr = 1.0, k = 0.0;
+    string paramsFile, outFile = "tuned.params";
+    vector<string> args;
+
+    for (int i = 1; i < argc; ++i) {
+        string a = argv[i];
+        if (a == "--threads" && i + 1 < argc) threads = max(1, atoi(argv[++i]));
+        else if (a == "--epochs" && i + 1 < argc) epochs = max(0, atoi(argv[++i]));
+        else if (a == "--lr" && i + 1 < argc) lr = atof(argv[++i]);
+        else if (a == "--k" && i + 1 < argc) k = atof(argv[++i]);
+        else if (a == "--params" && i + 1 < argc) paramsFile = argv[++i];
+        else if (a == "--out" && i + 1 < argc) outFile = argv[++i];
+        else if (a.rfind("--", 0) == 0) return usage(argv[0]);
+        else args.push_back(a);
+    }
+    if (args.size() != 1) return usage(argv[0]);
+
+    EvalParams start = default_eval_params();
+    if (!paramsFile.empty() && !load_eval_params(paramsFile, start)) {
+        cerr << "Could not read parameters " << paramsFile << "\n";
+        return 1;
+    }
+    apply_eval_params(start);
+
+    auto begin = chrono::steady_clock::now();
+    auto elapsed = [&] { return chrono::duration<double>(chrono::steady_clock::now() - begin).count(); };
+
+    vector<Shard> shards = load(args[0], threads);
+    uint64_t count = 0, features = 0, skipped = 0, mismatches = 0;
+    for (const Shard &s : shards) {
+        count += s.positions.size();
+        features += s.features.size();
+        skipped += s.skipped;
+        mismatches += s.mismatches;
+    }
+    if (!count) {
+        cerr << "No positions in " << args[0] << "\n";
+        return 1;
+    }
+    cout << count << " positions, " << skipped << " skipped, " << fixed << setprecision(1)
+         << double(features) / double(count) << " features per position, loaded in " << elapsed() << " s\n";
+    if (mismatches) cout << mismatches << " positions whose evaluation the linear model does not reproduce\n";
+
+    vector<double> w(WEIGHTS);
+    for (size_t i = 0; i < EVAL_PARAM_COUNT; ++i) {
+        w[2 * i] = mg_value(start.begin()[i]);
+        w[2 * i + 1] = eg_value(start.begin()[i]);
+    }
+
+    if (k <= 0) k = fit_k(shards, w, count);
+    cout << "K " << scientific << setprecision(4) << k << fixed << "  loss " << setprecision(6)
+         << loss(shards, w, k, count) << "\n";
+
+    // Adam with the usual decay rates
+    constexpr double BETA1 = 0.9, BETA2 = 0.999, EPSILON = 1e-8;
+    vector<double> grad(WEIGHTS), m(WEIGHTS, 0.0), v(WEIGHTS, 0.0);
+    for (int epoch = 1; epoch <= epochs; ++epoch) {
+        const double l = gradient(shards, w, k, count, grad);
+        const double c1 = 1 - pow(BETA1, epoch), c2 = 1 - pow(BETA2, epoch);
+        for (size_t i = 0; i < WEIGHTS; ++i) {
+            m[i] = BETA1 * m[i] + (1 - BETA1) * grad[i];
+            v[i] = BETA2 * v[i] + (1 - BETA2) * grad[i] * grad[i];
+            w[i] -= lr * (m[i] / c1) / (sqrt(v[i] / c2) + EPSILON);
+        }
+
+        if (epoch % 10 == 0 || epoch == epochs) {
+            cout << "epoch " << epoch << "  loss " << setprecision(6) << l << "  " << setprecision(1) << elapsed() << " s" << endl;
+        }
+        if ((epoch % 50 == 0 || epoch == epochs) && !save_eval_params(outFile, to_params(w))) {
+            cerr << "Could not write " << outFile << "\n";
+            return 1;
+        }
+    }
+
+    // the weights that moved the most, to see where the hand-picked values were off
+    const EvalParams tuned = to_params(w);
+    vector<size_t> order(EVAL_PARAM_COUNT);
+    iota(order.begin(), order.end(), size_t(0));
+    auto change = [&](size_t i) {
+        return abs(mg_value(tuned.begin()[i]) - mg_value(start.begin()[i]))
+               + abs(eg_value(tuned.begin()[i]) - eg_value(start.begin()[i]));
+    };
+    sort(order.begin(), order.end(), [&](size_t a, size_t b) { return change(a) > change(b); });
+    for (size_t j = 0; j < min<size_t>(10, order.size()) && epochs > 0; ++j) {
+        const size_t i = order[j];
+        cout << setw(24) << left << eval_param_name(i) << right
+             << " S(" << mg_value(start.begin()[i]) << ", " << eg_value(start.begin()[i]) << ") -> S("
+             << mg_value(tuned.begin()[i]) << ", " << eg_value(tuned.begin()[i]) << ")\n";
+    }
+    return 0;
+}